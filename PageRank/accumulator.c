@@ -0,0 +1,43 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "accumulator.h"
+
+// Allocates accumulators for the given number of documents, all cleared
+accumulators newAccumulators(int size) {
+    accumulators acc = malloc(sizeof(struct _accumulators));
+    acc->size = size;
+    acc->scores = calloc(size, sizeof(double));
+    acc->counts = calloc(size, sizeof(int));
+    acc->numTouched = 0;
+    acc->touched = calloc(size, sizeof(int));
+    return acc;
+}
+
+// Adds the score of one more query term found in a document
+void addScore(accumulators acc, int id, double score) {
+    if (acc->counts[id] == 0) {
+        acc->touched[acc->numTouched] = id;
+        acc->numTouched++;
+    }
+
+    acc->scores[id] += score;
+    acc->counts[id]++;
+}
+
+// Clears the documents touched by the last query, ready for the next
+void clearAccumulators(accumulators acc) {
+    for (int i = 0; i < acc->numTouched; i++) {
+        acc->scores[acc->touched[i]] = 0;
+        acc->counts[acc->touched[i]] = 0;
+    }
+    acc->numTouched = 0;
+}
+
+// Frees the memory occupied by accumulators
+void freeAccumulators(accumulators acc) {
+    free(acc->scores);
+    free(acc->counts);
+    free(acc->touched);
+    free(acc);
+}
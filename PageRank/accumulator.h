@@ -0,0 +1,22 @@
+#ifndef ACCUMULATOR_H
+#define ACCUMULATOR_H
+
+typedef struct _accumulators *accumulators;
+
+// Scores of the documents matching a query, held in arrays indexed by
+// document ID. The documents touched by a query are listed so that only
+// they need clearing before the next one
+struct _accumulators {
+    int size;
+    double *scores;
+    int *counts;            // Number of query terms found in each document
+    int numTouched;
+    int *touched;           // Documents found so far, in the order first found
+};
+
+accumulators newAccumulators(int size);
+void addScore(accumulators acc, int id, double score);
+void clearAccumulators(accumulators acc);
+void freeAccumulators(accumulators acc);
+
+#endif
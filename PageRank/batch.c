@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "batch.h"
+#include "indexer.h"
+
+// Searches read from a batch file, shared by the threads running them. Each
+// thread takes the next search not yet taken and writes its results to a
+// buffer of its own
+struct batchTask {
+    char *program;
+    struct rankIndexes *indexes;
+    struct searchOptions *options;
+    int numSearches;
+    char **lines;
+    char **results;
+    size_t *sizes;
+    int next;
+    pthread_mutex_t lock;
+};
+
+static void *runSearches(void *arg);
+static void runSearch(struct batchTask *task, int i);
+
+// Runs the searches in the file given with -batch, or in standard input if
+// it is "-", with the indexes loaded once for all of them
+void searchBatch(char *program, struct searchOptions *options) {
+    FILE *in = strcmp(options->batch, "-") == 0 ? stdin : fopen(options->batch, "r");
+    if (in == NULL) {
+        printf("ERROR: Could not open batch file '%s'\n", options->batch);
+        exit(1);
+    }
+
+    struct rankIndexes indexes;
+    char *error = loadRankIndexes(&indexes);
+    if (error != NULL) {
+        printf("%s\n", error);
+        exit(1);
+    }
+    runBatch(program, &indexes, options, in, stdout);
+    freeRankIndexes(&indexes);
+
+    if (in != stdin) fclose(in);
+}
+
+// Runs each search in a file, one per line, ranked as the named program
+// would. Searches run in parallel, in batches of BATCH_SIZE, but their
+// results are written in the order given, each followed by an empty line
+void runBatch(char *program, struct rankIndexes *indexes, struct searchOptions *options,
+    FILE *in, FILE *out) {
+    int numThreads = options->numThreads > 0 ? options->numThreads : defaultThreads();
+    pthread_t *threads = calloc(numThreads, sizeof(pthread_t));
+
+    struct batchTask task;
+    task.program = program;
+    task.indexes = indexes;
+    task.options = options;
+    task.lines = calloc(BATCH_SIZE, sizeof(char *));
+    task.results = calloc(BATCH_SIZE, sizeof(char *));
+    task.sizes = calloc(BATCH_SIZE, sizeof(size_t));
+    pthread_mutex_init(&task.lock, NULL);
+
+    size_t lineSize = 0;
+    char *line = NULL;
+    int done = 0;
+
+    while (!done) {
+        task.numSearches = 0;
+        task.next = 0;
+        while (task.numSearches < BATCH_SIZE) {
+            if (getline(&line, &lineSize, in) < 0) {
+                done = 1;
+                break;
+            }
+            task.lines[task.numSearches] = line;
+            task.numSearches++;
+            line = NULL;
+            lineSize = 0;
+        }
+
+        // Run the batch on as many threads as it can keep busy
+        int numStarted = numThreads < task.numSearches ? numThreads : task.numSearches;
+        for (int i = 0; i < numStarted; i++) pthread_create(&threads[i], NULL, runSearches, &task);
+        for (int i = 0; i < numStarted; i++) pthread_join(threads[i], NULL);
+
+        for (int i = 0; i < task.numSearches; i++) {
+            fwrite(task.results[i], 1, task.sizes[i], out);
+            fputc('\n', out);
+            free(task.results[i]);
+            free(task.lines[i]);
+        }
+    }
+
+    free(line);
+    pthread_mutex_destroy(&task.lock);
+    free(task.lines);
+    free(task.results);
+    free(task.sizes);
+    free(threads);
+}
+
+// Runs the searches of a batch not yet taken by another thread
+static void *runSearches(void *arg) {
+    struct batchTask *task = arg;
+
+    while (1) {
+        pthread_mutex_lock(&task->lock);
+        int i = task->next;
+        task->next++;
+        pthread_mutex_unlock(&task->lock);
+
+        if (i >= task->numSearches) return NULL;
+        runSearch(task, i);
+    }
+}
+
+// Runs one search of a batch, keeping its results or error message
+static void runSearch(struct batchTask *task, int i) {
+    FILE *out = open_memstream(&task->results[i], &task->sizes[i]);
+    char **terms;
+    int numTerms = splitSearchLine(task->lines[i], &terms);
+
+    stringList searchTerms = parseSearchTerms(numTerms, terms, 0);
+    char *error = rankSearch(task->program, task->indexes, task->options, searchTerms, out);
+    if (error != NULL) fprintf(out, "%s\n", error);
+
+    freeStringList(searchTerms);
+    free(terms);
+    fclose(out);
+}
@@ -0,0 +1,15 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+
+#include "rank.h"
+
+// Number of searches read and run together before their results are written
+#define BATCH_SIZE 1024
+
+void searchBatch(char *program, struct searchOptions *options);
+void runBatch(char *program, struct rankIndexes *indexes, struct searchOptions *options,
+    FILE *in, FILE *out);
+
+#endif
@@ -0,0 +1,480 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "text.h"
+#include "search.h"
+#include "indexer.h"
+#include "impact.h"
+#include "rank.h"
+
+#define DEFAULT_DOCS 2000
+#define DEFAULT_VOCABULARY 20000
+#define DEFAULT_LENGTH 200
+#define DEFAULT_QUERIES 2000
+#define DEFAULT_RESULTS "benchResults.json"
+
+// Links out of each synthetic page, and words on each line of its text
+#define LINKS_PER_PAGE 8
+#define WORDS_PER_LINE 12
+
+// Exponent of the Zipf distribution words are drawn from
+#define ZIPF_EXPONENT 1.0
+
+// Most words in a generated search
+#define MAX_QUERY_TERMS 3
+
+// Searches run untimed before each ranking is measured
+#define WARMUP_QUERIES 100
+
+#define MAX_LINE 1024
+
+// A way of ranking searches that is measured
+struct benchMode {
+    char *name;
+    char *program;
+    int impact;
+};
+
+// Latencies and allocations measured for one way of ranking
+struct benchResult {
+    double p50;
+    double p95;
+    double p99;
+    double qps;
+    double allocations;     // Per search, negative if they cannot be counted
+    int errors;
+};
+
+static struct benchMode modes[] = {
+    {"pagerank", RANK_PAGERANK, 0},
+    {"tfidf", RANK_TFIDF, 0},
+    {"tfidf-impact", RANK_TFIDF, 1},
+};
+
+#define NUM_MODES (int)(sizeof(modes) / sizeof(modes[0]))
+
+void printUsage();
+void writeCorpus(int numDocs, int vocabulary, int length);
+void writeQueryLog(char *filename, int numQueries, int vocabulary);
+char **readQueryLog(char *filename, int *numQueries);
+double *zipfTable(int vocabulary);
+int drawZipf(double *cdf, int vocabulary);
+void wordName(int rank, char *word);
+unsigned int nextRandom();
+struct benchResult runQueries(struct benchMode *mode, struct rankIndexes *indexes,
+    char **queries, int numQueries);
+double percentile(double *sorted, int count, double p);
+int compareDoubles(const void *a, const void *b);
+double elapsedSeconds(struct timespec *start);
+void writeJsonString(FILE *file, char *string);
+long countAllocations();
+
+static unsigned int randomState = 2463534242u;
+
+int main(int argc, char *argv[]) {
+    int numDocs = DEFAULT_DOCS;
+    int vocabulary = DEFAULT_VOCABULARY;
+    int length = DEFAULT_LENGTH;
+    int numQueries = DEFAULT_QUERIES;
+    char *queryLog = NULL;
+    char *label = "";
+    char *results = DEFAULT_RESULTS;
+    int arg = 1;
+
+    while (arg + 1 < argc && argv[arg][0] == '-') {
+        if (strcmp(argv[arg], "-docs") == 0) numDocs = atoi(argv[arg + 1]);
+        else if (strcmp(argv[arg], "-vocabulary") == 0) vocabulary = atoi(argv[arg + 1]);
+        else if (strcmp(argv[arg], "-length") == 0) length = atoi(argv[arg + 1]);
+        else if (strcmp(argv[arg], "-queries") == 0) numQueries = atoi(argv[arg + 1]);
+        else if (strcmp(argv[arg], "-log") == 0) queryLog = argv[arg + 1];
+        else if (strcmp(argv[arg], "-label") == 0) label = argv[arg + 1];
+        else if (strcmp(argv[arg], "-o") == 0) results = argv[arg + 1];
+        else {
+            printf("ERROR: Unknown option '%s'\n", argv[arg]);
+            printUsage();
+        }
+        arg += 2;
+    }
+
+    if (arg + 1 != argc) printUsage();
+    if (numDocs < 2 || vocabulary < 1 || length < 1 || numQueries < 1) {
+        printf("ERROR: Corpus and log sizes must be positive\n");
+        printUsage();
+    }
+
+    // The log is read once in the corpus directory
+    if (queryLog != NULL) {
+        char *path = realpath(queryLog, NULL);
+        if (path == NULL) {
+            printf("ERROR: Could not open query log '%s'\n", queryLog);
+            exit(1);
+        }
+        queryLog = path;
+    }
+
+    // Results are added to, so that runs of different builds can be compared
+    FILE *output = fopen(results, "a");
+    if (output == NULL) {
+        printf("ERROR: Could not write results to file '%s'\n", results);
+        exit(1);
+    }
+
+    // Build the corpus where it cannot replace a real one
+    char *directory = argv[arg];
+    mkdir(directory, 0755);
+    if (chdir(directory) != 0) {
+        printf("ERROR: Could not open directory '%s'\n", directory);
+        exit(1);
+    }
+    if (access("collection.txt", F_OK) == 0) {
+        printf("ERROR: '%s' already holds a collection\n", directory);
+        exit(1);
+    }
+
+    printf("Writing %d pages of %d words from %d distinct words\n", numDocs, length, vocabulary);
+    writeCorpus(numDocs, vocabulary, length);
+    if (queryLog == NULL) {
+        writeQueryLog("queries.txt", numQueries, vocabulary);
+        queryLog = "queries.txt";
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    buildInvertedIndex("collection.txt", "invertedIndex.txt", BASE_INDEX, BASE_FORWARD, NULL,
+        defaultThreads());
+    buildImpactIndex(BASE_INDEX, BASE_FORWARD, BASE_IMPACT);
+    double indexSeconds = elapsedSeconds(&start);
+    printf("Indexed in %.3f seconds\n", indexSeconds);
+
+    // Pageranks are drawn at random, as only their lookup is measured
+    char **urls = malloc(numDocs * sizeof(char *));
+    double *ranks = malloc(numDocs * sizeof(double));
+    FILE *list = fopen(PAGERANK_LIST, "w");
+    for (int i = 0; i < numDocs; i++) {
+        char url[MAX_LINE];
+        sprintf(url, "url%d", i);
+        urls[i] = strdup(url);
+        ranks[i] = (double)nextRandom() / UINT32_MAX / numDocs;
+        fprintf(list, "%s, %d, " PAGERANK_FORMAT "\n", url, LINKS_PER_PAGE, ranks[i]);
+    }
+    fclose(list);
+    writePagerankIndex(urls, ranks, numDocs, PAGERANK_INDEX);
+
+    char **queries = readQueryLog(queryLog, &numQueries);
+    struct rankIndexes indexes;
+    char *error = loadRankIndexes(&indexes);
+    if (error != NULL) {
+        printf("%s\n", error);
+        exit(1);
+    }
+
+    // Write the run as one line of JSON
+    time_t now = time(NULL);
+    char stamp[64];
+    strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+    fprintf(output, "{\"label\": ");
+    writeJsonString(output, label);
+    fprintf(output, ", \"time\": \"%s\", \"docs\": %d, \"vocabulary\": %d, "
+        "\"docLength\": %d, \"queries\": %d, \"indexSeconds\": %.6f, \"modes\": {",
+        stamp, numDocs, vocabulary, length, numQueries, indexSeconds);
+
+    printf("%-14s %10s %10s %10s %10s %12s\n", "ranking", "p50 us", "p95 us", "p99 us", "qps",
+        "allocs/query");
+    for (int m = 0; m < NUM_MODES; m++) {
+        struct benchResult r = runQueries(&modes[m], &indexes, queries, numQueries);
+
+        printf("%-14s %10.1f %10.1f %10.1f %10.1f %12.1f\n", modes[m].name, r.p50, r.p95, r.p99,
+            r.qps, r.allocations);
+        if (r.errors > 0) printf("%d searches with %s failed\n", r.errors, modes[m].name);
+
+        fprintf(output, "%s\"%s\": {\"p50Us\": %.3f, \"p95Us\": %.3f, \"p99Us\": %.3f, "
+            "\"qps\": %.3f, \"allocationsPerQuery\": ", m > 0 ? ", " : "", modes[m].name,
+            r.p50, r.p95, r.p99, r.qps);
+        if (r.allocations < 0) fprintf(output, "null");
+        else fprintf(output, "%.3f", r.allocations);
+        fprintf(output, ", \"errors\": %d}", r.errors);
+    }
+    fprintf(output, "}}\n");
+    fclose(output);
+
+    freeRankIndexes(&indexes);
+    for (int i = 0; i < numQueries; i++) free(queries[i]);
+    free(queries);
+    for (int i = 0; i < numDocs; i++) free(urls[i]);
+    free(urls);
+    free(ranks);
+    return 0;
+}
+
+// Prints how to run the program, and exits
+void printUsage() {
+    printf("bench [-docs N] [-vocabulary N] [-length N] [-queries N] [-log FILE] "
+        "[-label NAME] [-o FILE] directory\n");
+    exit(1);
+}
+
+// Writes a collection of pages whose words follow a Zipf distribution,
+// each linking to pages chosen at random
+void writeCorpus(int numDocs, int vocabulary, int length) {
+    double *cdf = zipfTable(vocabulary);
+    FILE *collection = fopen("collection.txt", "w");
+    char word[MAX_LINE];
+
+    for (int i = 0; i < numDocs; i++) {
+        char url[MAX_LINE];
+        sprintf(url, "url%d.txt", i);
+        FILE *page = fopen(url, "w");
+        if (page == NULL) {
+            printf("ERROR: Could not write page '%s'\n", url);
+            exit(1);
+        }
+
+        fprintf(page, "#start Section-1\n\n");
+        for (int l = 0; l < LINKS_PER_PAGE; l++) {
+            fprintf(page, "url%d%c", nextRandom() % numDocs, l + 1 < LINKS_PER_PAGE ? ' ' : '\n');
+        }
+        fprintf(page, "\n#end Section-1\n\n#start Section-2\n");
+        for (int w = 0; w < length; w++) {
+            wordName(drawZipf(cdf, vocabulary), word);
+            fprintf(page, "%s%c", word, (w + 1) % WORDS_PER_LINE == 0 || w + 1 == length ? '\n' : ' ');
+        }
+        fprintf(page, "#end Section-2\n");
+        fclose(page);
+
+        fprintf(collection, "url%d%c", i, (i + 1) % WORDS_PER_LINE == 0 ? '\n' : ' ');
+    }
+
+    fprintf(collection, "\n");
+    fclose(collection);
+    free(cdf);
+}
+
+// Writes searches of one to MAX_QUERY_TERMS words drawn from the same
+// distribution as the pages, so that popular searches repeat
+void writeQueryLog(char *filename, int numQueries, int vocabulary) {
+    double *cdf = zipfTable(vocabulary);
+    FILE *log = fopen(filename, "w");
+    char word[MAX_LINE];
+
+    for (int q = 0; q < numQueries; q++) {
+        int numTerms = 1 + nextRandom() % MAX_QUERY_TERMS;
+        for (int t = 0; t < numTerms; t++) {
+            wordName(drawZipf(cdf, vocabulary), word);
+            fprintf(log, "%s%c", word, t + 1 < numTerms ? ' ' : '\n');
+        }
+    }
+
+    fclose(log);
+    free(cdf);
+}
+
+// Reads a query log of one search per line, as given to -batch
+char **readQueryLog(char *filename, int *numQueries) {
+    FILE *log = fopen(filename, "r");
+    if (log == NULL) {
+        printf("ERROR: Could not open query log '%s'\n", filename);
+        exit(1);
+    }
+
+    int capacity = 1024;
+    char **queries = malloc(capacity * sizeof(char *));
+    char buffer[MAX_LINE];
+    *numQueries = 0;
+
+    while (fgets(buffer, MAX_LINE, log)) {
+        if (*numQueries == capacity) {
+            capacity *= 2;
+            queries = realloc(queries, capacity * sizeof(char *));
+        }
+        queries[*numQueries] = strdup(buffer);
+        (*numQueries)++;
+    }
+    fclose(log);
+
+    if (*numQueries == 0) {
+        printf("ERROR: Query log '%s' is empty\n", filename);
+        exit(1);
+    }
+    return queries;
+}
+
+// Returns the chance of drawing each word rank or any before it
+double *zipfTable(int vocabulary) {
+    double *cdf = malloc(vocabulary * sizeof(double));
+    double total = 0;
+
+    for (int r = 0; r < vocabulary; r++) {
+        total += 1 / pow(r + 1, ZIPF_EXPONENT);
+        cdf[r] = total;
+    }
+    for (int r = 0; r < vocabulary; r++) cdf[r] /= total;
+
+    return cdf;
+}
+
+// Draws a word rank, most often the lowest
+int drawZipf(double *cdf, int vocabulary) {
+    double x = (double)nextRandom() / UINT32_MAX;
+    int low = 0;
+    int high = vocabulary - 1;
+
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (cdf[middle] < x) low = middle + 1;
+        else high = middle;
+    }
+    return low;
+}
+
+// Writes the word for a rank, made of letters so that it is never cleaned
+// into another word
+void wordName(int rank, char *word) {
+    int i = 0;
+    word[i++] = 'w';
+    do {
+        word[i++] = 'a' + rank % 26;
+        rank /= 26;
+    } while (rank > 0);
+    word[i] = '\0';
+}
+
+// Returns the next number of a fixed xorshift sequence, so that every run
+// builds the same corpus and log
+unsigned int nextRandom() {
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+// Runs every search in the log ranked one way, timing each, after a few
+// untimed searches to warm up the indexes
+struct benchResult runQueries(struct benchMode *mode, struct rankIndexes *indexes,
+    char **queries, int numQueries) {
+    struct benchResult result;
+    double *latencies = malloc(numQueries * sizeof(double));
+    FILE *out = fopen("/dev/null", "w");
+
+    struct searchOptions options;
+    options.minMatch = MATCH_ANY;
+    options.impact = mode->impact;
+    options.weighted = 0;
+    options.batch = NULL;
+    options.numThreads = 0;
+
+    result.errors = 0;
+    long allocations = 0;
+    double total = 0;
+
+    for (int i = -WARMUP_QUERIES; i < numQueries; i++) {
+        char *line = strdup(queries[(i % numQueries + numQueries) % numQueries]);
+        struct timespec start;
+        long allocated = countAllocations();
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        char **terms;
+        int numTerms = splitSearchLine(line, &terms);
+        stringList searchTerms = parseSearchTerms(numTerms, terms, 0);
+        char *error = rankSearch(mode->program, indexes, &options, searchTerms, out);
+        freeStringList(searchTerms);
+        free(terms);
+
+        double seconds = elapsedSeconds(&start);
+        if (i >= 0) {
+            latencies[i] = seconds * 1e6;
+            total += seconds;
+            allocations += countAllocations() - allocated;
+            if (error != NULL) result.errors++;
+        }
+        free(line);
+    }
+
+    qsort(latencies, numQueries, sizeof(double), compareDoubles);
+    result.p50 = percentile(latencies, numQueries, 0.50);
+    result.p95 = percentile(latencies, numQueries, 0.95);
+    result.p99 = percentile(latencies, numQueries, 0.99);
+    result.qps = total > 0 ? numQueries / total : 0;
+    result.allocations = countAllocations() < 0 ? -1 : (double)allocations / numQueries;
+
+    fclose(out);
+    free(latencies);
+    return result;
+}
+
+// Returns the nearest-rank percentile of sorted values
+double percentile(double *sorted, int count, double p) {
+    int rank = ceil(p * count);
+    if (rank < 1) rank = 1;
+    return sorted[rank - 1];
+}
+
+int compareDoubles(const void *a, const void *b) {
+    double x = *(double *)a;
+    double y = *(double *)b;
+    return (x > y) - (x < y);
+}
+
+// Returns the seconds since a time taken from the monotonic clock
+double elapsedSeconds(struct timespec *start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Writes a string as a quoted JSON string, escaping quotes, backslashes
+// and control characters
+void writeJsonString(FILE *file, char *string) {
+    fputc('"', file);
+    for (unsigned char *c = (unsigned char *)string; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') fprintf(file, "\\%c", *c);
+        else if (*c < 0x20) fprintf(file, "\\u%04x", *c);
+        else fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+#ifdef __GLIBC__
+
+// glibc lets a program replace malloc, so the benchmark counts every
+// allocation, including those made inside the C library, before passing
+// it on to glibc's own
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *pointer, size_t size);
+
+static long numAllocations = 0;
+
+void *malloc(size_t size) {
+    __atomic_fetch_add(&numAllocations, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    __atomic_fetch_add(&numAllocations, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size) {
+    __atomic_fetch_add(&numAllocations, 1, __ATOMIC_RELAXED);
+    return __libc_realloc(pointer, size);
+}
+
+// Returns the number of allocations made so far
+long countAllocations() {
+    return __atomic_load_n(&numAllocations, __ATOMIC_RELAXED);
+}
+
+#else
+
+// Returns -1, as allocations can only be counted with glibc
+long countAllocations() {
+    return -1;
+}
+
+#endif
@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bloom.h"
+
+static unsigned long long hashBloom(char *term);
+static unsigned int findBlock(unsigned long long hash, unsigned int numBlocks);
+static int probeBlock(unsigned char *block, unsigned long long hash, int set);
+
+// Builds a Bloom filter holding every term of a dictionary, and sets the
+// number of blocks it takes
+unsigned char *buildBloomFilter(char **terms, int numTerms, unsigned int *numBlocks) {
+    unsigned int bits = BLOOM_BLOCK_SIZE * 8;
+    *numBlocks = ((unsigned long)numTerms * BLOOM_BITS_PER_TERM + bits - 1) / bits;
+    if (*numBlocks == 0) *numBlocks = 1;
+
+    unsigned char *filter = calloc(*numBlocks, BLOOM_BLOCK_SIZE);
+    for (int t = 0; t < numTerms; t++) {
+        unsigned long long hash = hashBloom(terms[t]);
+        probeBlock(filter + findBlock(hash, *numBlocks) * BLOOM_BLOCK_SIZE, hash, 1);
+    }
+
+    return filter;
+}
+
+// Returns 0 if a term is certainly not in the filter's dictionary, and 1
+// if it may be
+int bloomMayContain(unsigned char *filter, unsigned int numBlocks, char *term) {
+    unsigned long long hash = hashBloom(term);
+    return probeBlock(filter + findBlock(hash, numBlocks) * BLOOM_BLOCK_SIZE, hash, 0);
+}
+
+// Rounds an offset in a file up to the start of a block, so that a filter
+// placed there keeps each block in one cache line once the file is mapped
+unsigned int alignBloomOffset(unsigned int offset) {
+    return (offset + BLOOM_BLOCK_SIZE - 1) / BLOOM_BLOCK_SIZE * BLOOM_BLOCK_SIZE;
+}
+
+// Returns a 64-bit FNV-1a hash of a term, mixed so that every bit depends
+// on every byte
+static unsigned long long hashBloom(char *term) {
+    unsigned long long hash = 14695981039346656037ull;
+    for (int i = 0; term[i] != '\0'; i++) {
+        hash ^= (unsigned char)term[i];
+        hash *= 1099511628211ull;
+    }
+
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// Chooses a term's block from the high bits of its hash, spread evenly
+// over any number of blocks
+static unsigned int findBlock(unsigned long long hash, unsigned int numBlocks) {
+    return ((hash >> 32) * numBlocks) >> 32;
+}
+
+// Visits a term's bits in its block, by double hashing on the low bits of
+// its hash, which are not used to choose the block. Sets them if set is
+// set. Returns whether they were all set already
+static int probeBlock(unsigned char *block, unsigned long long hash, int set) {
+    unsigned int bits = BLOOM_BLOCK_SIZE * 8;
+    unsigned int bit = hash % bits;
+    unsigned int step = (hash / bits) % bits | 1;
+    int found = 1;
+
+    for (int p = 0; p < BLOOM_PROBES; p++) {
+        if ((block[bit / 8] & (1 << (bit % 8))) == 0) {
+            if (!set) return 0;
+            found = 0;
+            block[bit / 8] |= 1 << (bit % 8);
+        }
+        bit = (bit + step) % bits;
+    }
+
+    return found;
+}
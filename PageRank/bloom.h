@@ -0,0 +1,21 @@
+#ifndef BLOOM_H
+#define BLOOM_H
+
+// Bytes in each block of a Bloom filter, one cache line
+#define BLOOM_BLOCK_SIZE 64
+
+// Bits given to each term, and bits set for it within its block
+#define BLOOM_BITS_PER_TERM 10
+#define BLOOM_PROBES 6
+
+// A blocked Bloom filter over the terms of a dictionary. Each term hashes
+// to one block, and sets BLOOM_PROBES bits inside it, so finding that a
+// term is not in the dictionary reads a single cache line. Terms that are
+// in the dictionary are always found, and about one term in a hundred that
+// is not is found too
+
+unsigned char *buildBloomFilter(char **terms, int numTerms, unsigned int *numBlocks);
+int bloomMayContain(unsigned char *filter, unsigned int numBlocks, char *term);
+unsigned int alignBloomOffset(unsigned int offset);
+
+#endif
@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cache.h"
+#include "index.h"
+
+#define INITIAL_SLOTS 64
+
+static cacheEntry *findBucket(resultCache cache, char *key, unsigned int hash);
+static int takeSlot(resultCache cache);
+static void evictEntry(resultCache cache);
+static void removeEntry(resultCache cache, cacheEntry entry);
+static size_t entrySize(char *key, size_t size);
+
+// Creates an empty cache holding at most capacity bytes of keys and results
+resultCache newResultCache(size_t capacity) {
+    resultCache cache = malloc(sizeof(struct _resultCache));
+    pthread_mutex_init(&cache->lock, NULL);
+    cache->capacity = capacity;
+    cache->used = 0;
+    cache->numBuckets = INITIAL_SLOTS;
+    cache->buckets = calloc(cache->numBuckets, sizeof(cacheEntry));
+    cache->numSlots = 0;
+    cache->clock = NULL;
+    cache->freeSlots = NULL;
+    cache->numFree = 0;
+    cache->hand = 0;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->evictions = 0;
+    cache->numEntries = 0;
+    return cache;
+}
+
+// Returns a copy of the results cached for a key, setting size to their
+// length, or NULL if there are none
+char *findCachedResult(resultCache cache, char *key, size_t *size) {
+    char *result = NULL;
+
+    pthread_mutex_lock(&cache->lock);
+    cacheEntry entry = *findBucket(cache, key, hashTerm(key));
+    if (entry != NULL) {
+        entry->referenced = 1;
+        result = malloc(entry->size + 1);
+        memcpy(result, entry->result, entry->size + 1);
+        *size = entry->size;
+        cache->hits++;
+    } else {
+        cache->misses++;
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    return result;
+}
+
+// Caches a copy of the results for a key, evicting entries until they fit.
+// Results too large to fit at all are not cached
+void cacheResult(resultCache cache, char *key, char *result, size_t size) {
+    size_t needed = entrySize(key, size);
+    unsigned int hash = hashTerm(key);
+
+    pthread_mutex_lock(&cache->lock);
+    cacheEntry *bucket = findBucket(cache, key, hash);
+    if (*bucket != NULL || needed > cache->capacity) {
+        pthread_mutex_unlock(&cache->lock);
+        return;
+    }
+
+    while (cache->used + needed > cache->capacity) evictEntry(cache);
+
+    cacheEntry entry = malloc(sizeof(struct _cacheEntry));
+    entry->key = strdup(key);
+    entry->result = malloc(size + 1);
+    memcpy(entry->result, result, size);
+    entry->result[size] = '\0';
+    entry->size = size;
+    entry->hash = hash;
+    entry->referenced = 0;
+    entry->slot = takeSlot(cache);
+    cache->clock[entry->slot] = entry;
+
+    // Evicting may have emptied the bucket, so find it again
+    bucket = findBucket(cache, key, hash);
+    entry->next = NULL;
+    *bucket = entry;
+    cache->used += needed;
+    cache->numEntries++;
+
+    pthread_mutex_unlock(&cache->lock);
+}
+
+// Removes every entry, keeping the counts of hits and misses
+void clearResultCache(resultCache cache) {
+    pthread_mutex_lock(&cache->lock);
+    for (int i = 0; i < cache->numSlots; i++) {
+        if (cache->clock[i] != NULL) removeEntry(cache, cache->clock[i]);
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
+
+// Writes how often searches were found in the cache, and what it holds
+void printCacheStats(resultCache cache, FILE *out) {
+    pthread_mutex_lock(&cache->lock);
+    long lookups = cache->hits + cache->misses;
+    fprintf(out, "Hits: %ld\n", cache->hits);
+    fprintf(out, "Misses: %ld\n", cache->misses);
+    fprintf(out, "Hit rate: %.4f\n", lookups > 0 ? (double)cache->hits / lookups : 0.0);
+    fprintf(out, "Evictions: %ld\n", cache->evictions);
+    fprintf(out, "Entries: %d\n", cache->numEntries);
+    fprintf(out, "Bytes: %zu of %zu\n", cache->used, cache->capacity);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+// Frees a cache and every entry in it
+void freeResultCache(resultCache cache) {
+    if (cache == NULL) return;
+
+    clearResultCache(cache);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache->buckets);
+    free(cache->clock);
+    free(cache->freeSlots);
+    free(cache);
+}
+
+// Returns the link to the entry for a key in its bucket, which holds NULL
+// if there is no such entry. The table is kept at most half full
+static cacheEntry *findBucket(resultCache cache, char *key, unsigned int hash) {
+    if (2 * cache->numEntries > cache->numBuckets) {
+        int numBuckets = 2 * cache->numBuckets;
+        cacheEntry *buckets = calloc(numBuckets, sizeof(cacheEntry));
+
+        for (int i = 0; i < cache->numBuckets; i++) {
+            cacheEntry entry = cache->buckets[i];
+            while (entry != NULL) {
+                cacheEntry next = entry->next;
+                int b = entry->hash & (numBuckets - 1);
+                entry->next = buckets[b];
+                buckets[b] = entry;
+                entry = next;
+            }
+        }
+
+        free(cache->buckets);
+        cache->buckets = buckets;
+        cache->numBuckets = numBuckets;
+    }
+
+    cacheEntry *link = &cache->buckets[hash & (cache->numBuckets - 1)];
+    while (*link != NULL && ((*link)->hash != hash || strcmp((*link)->key, key) != 0)) {
+        link = &(*link)->next;
+    }
+    return link;
+}
+
+// Returns a free position on the clock, adding positions if none are free.
+// A position freed by the hand is just behind it, so a new entry there is
+// the last the hand reaches
+static int takeSlot(resultCache cache) {
+    if (cache->numFree == 0) {
+        int numSlots = cache->numSlots > 0 ? 2 * cache->numSlots : INITIAL_SLOTS;
+        cache->clock = realloc(cache->clock, numSlots * sizeof(cacheEntry));
+        cache->freeSlots = realloc(cache->freeSlots, numSlots * sizeof(int));
+
+        // Push the new positions so that the first is taken first
+        for (int i = numSlots - 1; i >= cache->numSlots; i--) {
+            cache->clock[i] = NULL;
+            cache->freeSlots[cache->numFree] = i;
+            cache->numFree++;
+        }
+        cache->numSlots = numSlots;
+    }
+
+    cache->numFree--;
+    return cache->freeSlots[cache->numFree];
+}
+
+// Moves the hand on until it reaches an entry not used since it last
+// passed, and evicts that entry
+static void evictEntry(resultCache cache) {
+    while (1) {
+        cacheEntry entry = cache->clock[cache->hand];
+        cache->hand = (cache->hand + 1) % cache->numSlots;
+
+        if (entry == NULL) continue;
+        if (entry->referenced) {
+            entry->referenced = 0;
+            continue;
+        }
+
+        removeEntry(cache, entry);
+        cache->evictions++;
+        return;
+    }
+}
+
+// Removes an entry from its bucket and the clock, and frees it
+static void removeEntry(resultCache cache, cacheEntry entry) {
+    cacheEntry *link = &cache->buckets[entry->hash & (cache->numBuckets - 1)];
+    while (*link != entry) link = &(*link)->next;
+    *link = entry->next;
+
+    cache->clock[entry->slot] = NULL;
+    cache->freeSlots[cache->numFree] = entry->slot;
+    cache->numFree++;
+    cache->used -= entrySize(entry->key, entry->size);
+    cache->numEntries--;
+
+    free(entry->key);
+    free(entry->result);
+    free(entry);
+}
+
+// Returns the bytes an entry takes, counting its key and results
+static size_t entrySize(char *key, size_t size) {
+    return sizeof(struct _cacheEntry) + strlen(key) + 1 + size + 1;
+}
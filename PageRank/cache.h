@@ -0,0 +1,53 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <pthread.h>
+
+// Default size of the search server's result cache, in megabytes
+#define DEFAULT_CACHE_MB 64
+
+typedef struct _resultCache *resultCache;
+typedef struct _cacheEntry *cacheEntry;
+
+// A search's results, found by its key
+struct _cacheEntry {
+    char *key;
+    char *result;
+    size_t size;
+    unsigned int hash;
+    int referenced;         // Whether it has been used since the clock hand last passed
+    int slot;               // Position on the clock
+    cacheEntry next;        // Next entry in the same bucket
+};
+
+// Results of recent searches, bounded by the bytes they take. When full,
+// entries are evicted by CLOCK: a hand sweeps round the entries, sparing
+// any used since it last passed but evicting the first that has not. Safe
+// to use from several threads at once
+struct _resultCache {
+    pthread_mutex_t lock;
+    size_t capacity;
+    size_t used;
+    int numBuckets;
+    cacheEntry *buckets;
+    int numSlots;
+    cacheEntry *clock;      // Entries in the order the hand visits them, NULL if free
+    int *freeSlots;
+    int numFree;
+    int hand;
+    long hits;
+    long misses;
+    long evictions;
+    int numEntries;
+};
+
+resultCache newResultCache(size_t capacity);
+char *findCachedResult(resultCache cache, char *key, size_t *size);
+void cacheResult(resultCache cache, char *key, char *result, size_t size);
+void clearResultCache(resultCache cache);
+void printCacheStats(resultCache cache, FILE *out);
+void freeResultCache(resultCache cache);
+
+#endif
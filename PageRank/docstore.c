@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "docstore.h"
+#include "indexer.h"
+#include "index.h"
+#include "loader.h"
+#include "text.h"
+
+// Names of the stored sections, in the order their spans are kept
+static char *storedSections[STORED_SECTIONS] = {"Section-1", "Section-2"};
+
+static unsigned long getModifiedTime(struct stat *info);
+
+// Packs the page of every URL in a collection into one page store, with
+// document IDs in collection order as the indexer numbers them. The store
+// is written to a temporary file and renamed into place, so readers see
+// either the old or the new store
+void writePageStore(char *collection, char *output) {
+    docTable docs = readDocTable(collection);
+    char *temporary = stringJoin(output, ".tmp");
+    FILE *file = fopen(temporary, "wb");
+
+    if (file == NULL) {
+        printf("ERROR: Could not write page store '%s'\n", temporary);
+        exit(1);
+    }
+
+    // Keep the hash table at most half full
+    unsigned int urlHashSize = 1;
+    while (urlHashSize < 2 * (unsigned int)docs->numDocs) urlHashSize *= 2;
+
+    struct pageStoreHeader header;
+    header.magic = PAGE_STORE_MAGIC;
+    header.version = PAGE_STORE_VERSION;
+    header.numPages = docs->numDocs;
+    header.numSections = STORED_SECTIONS;
+    header.urlHashSize = urlHashSize;
+    header.pagesOffset = sizeof(struct pageStoreHeader);
+    header.urlHashOffset = header.pagesOffset + docs->numDocs * sizeof(struct storedPage);
+    header.dataOffset = header.urlHashOffset + urlHashSize * sizeof(unsigned int);
+
+    struct storedPage *pages = calloc(docs->numDocs, sizeof(struct storedPage));
+    unsigned int *urlHash = calloc(urlHashSize, sizeof(unsigned int));
+    fseek(file, header.dataOffset, SEEK_SET);
+
+    // Files are looked at before they are read, so a page changed while it
+    // is packed is taken as out of date rather than as current
+    for (int id = 0; id < docs->numDocs; id++) {
+        char *filename = stringJoin(docs->urls[id], ".txt");
+        struct stat info;
+        if (stat(filename, &info) != 0) {
+            printf("ERROR: Could not read page '%s'\n", filename);
+            exit(1);
+        }
+        pages[id].modified = getModifiedTime(&info);
+        free(filename);
+    }
+
+    // Stored pages are not read here, as they may be the ones out of date
+    pageReader reader = openPageReader(docs->urls, docs->numDocs, READ_URING);
+    unsigned long dataSize = 0;
+
+    for (int id = 0; id < docs->numDocs; id++) {
+        char *contents = nextPage(reader);
+        if (contents == NULL) {
+            printf("ERROR: Could not read page '%s.txt'\n", docs->urls[id]);
+            exit(1);
+        }
+
+        size_t urlLength = strlen(docs->urls[id]) + 1;
+        size_t size = strlen(contents);
+
+        pages[id].url = dataSize;
+        pages[id].contents = dataSize + urlLength;
+        pages[id].size = size;
+        for (int s = 0; s < STORED_SECTIONS; s++) {
+            int length;
+            pages[id].sections[s].start = findSectionSpan(contents, storedSections[s], &length);
+            pages[id].sections[s].length = length;
+        }
+
+        fwrite(docs->urls[id], 1, urlLength, file);
+        fwrite(contents, 1, size + 1, file);
+        dataSize += urlLength + size + 1;
+
+        unsigned int slot = hashTerm(docs->urls[id]) & (urlHashSize - 1);
+        while (urlHash[slot] != 0) slot = (slot + 1) & (urlHashSize - 1);
+        urlHash[slot] = id + 1;
+    }
+    closePageReader(reader);
+
+    rewind(file);
+    fwrite(&header, sizeof(struct pageStoreHeader), 1, file);
+    fwrite(pages, sizeof(struct storedPage), docs->numDocs, file);
+    fwrite(urlHash, sizeof(unsigned int), urlHashSize, file);
+
+    if (fclose(file) != 0) {
+        printf("ERROR: Could not write page store '%s'\n", temporary);
+        exit(1);
+    }
+    rename(temporary, output);
+
+    free(temporary);
+    free(pages);
+    free(urlHash);
+    freeDocTable(docs);
+}
+
+// Maps a page store into memory. Returns NULL if there is no store, or it
+// is not a page store of this version
+pageStore openPageStore(char *filename) {
+    if (access(filename, R_OK) != 0) return NULL;
+
+    size_t size;
+    void *map = mapFile(filename, sizeof(struct pageStoreHeader), &size);
+    struct pageStoreHeader *header = map;
+
+    if (map == NULL || header->magic != PAGE_STORE_MAGIC || header->version != PAGE_STORE_VERSION ||
+        header->numSections != STORED_SECTIONS || header->dataOffset > size) {
+        if (map != NULL) munmap(map, size);
+        return NULL;
+    }
+
+    pageStore store = malloc(sizeof(struct _pageStore));
+    store->map = map;
+    store->size = size;
+    store->header = header;
+    store->pages = (struct storedPage *)((char *)map + header->pagesOffset);
+    store->urlHash = (unsigned int *)((char *)map + header->urlHashOffset);
+    store->data = (char *)map + header->dataOffset;
+    return store;
+}
+
+// Unmaps a page store and frees its memory
+void closePageStore(pageStore store) {
+    if (store == NULL) return;
+    munmap(store->map, store->size);
+    free(store);
+}
+
+// Returns the document ID of a URL's page, or NOT_STORED if it is not in
+// the store
+int findStoredPage(pageStore store, char *url) {
+    unsigned int mask = store->header->urlHashSize - 1;
+    unsigned int slot = hashTerm(url) & mask;
+
+    while (store->urlHash[slot] != 0) {
+        int id = store->urlHash[slot] - 1;
+        if (strcmp(getStoredUrl(store, id), url) == 0) return id;
+        slot = (slot + 1) & mask;
+    }
+
+    return NOT_STORED;
+}
+
+// Returns the URL of a stored page
+char *getStoredUrl(pageStore store, int id) {
+    return store->data + store->pages[id].url;
+}
+
+// Returns the contents of a stored page, ending in a NUL byte
+char *getStoredContents(pageStore store, int id) {
+    return store->data + store->pages[id].contents;
+}
+
+// Returns where a section starts in a stored page, and sets its length.
+// The section is not followed by a NUL byte. Returns NULL if the section
+// is not one that is stored
+char *getStoredSection(pageStore store, int id, char *section, int *length) {
+    for (int s = 0; s < STORED_SECTIONS; s++) {
+        if (strcmp(section, storedSections[s]) != 0) continue;
+
+        struct pageSpan *span = &store->pages[id].sections[s];
+        *length = span->length;
+        return getStoredContents(store, id) + span->start;
+    }
+
+    return NULL;
+}
+
+// Returns whether a stored page is the same as its file, given the file's
+// status. A page whose size or modification time has changed since it was
+// packed must be read from its file instead
+int isStoredPageCurrent(pageStore store, int id, struct stat *info) {
+    struct storedPage *page = &store->pages[id];
+    return (unsigned long)info->st_size == page->size && getModifiedTime(info) == page->modified;
+}
+
+// Returns a file's modification time in nanoseconds
+static unsigned long getModifiedTime(struct stat *info) {
+    return (unsigned long)info->st_mtim.tv_sec * 1000000000UL + info->st_mtim.tv_nsec;
+}
@@ -0,0 +1,70 @@
+#ifndef DOCSTORE_H
+#define DOCSTORE_H
+
+#include <stddef.h>
+#include <sys/stat.h>
+
+#define PAGE_STORE "pages.bin"
+#define PAGE_STORE_MAGIC 0x53474150
+#define PAGE_STORE_VERSION 2
+
+// Sections whose place in each page is found when the page is packed
+#define STORED_SECTIONS 2
+
+#define NOT_STORED -1
+
+typedef struct _pageStore *pageStore;
+
+// Page store layout: the header, the pages by document ID, then a hash
+// table mapping URL hashes to document IDs plus one, with zero marking an
+// empty slot. The data region follows, holding each page's URL then its
+// contents, each ending in a NUL byte. Offsets in the header are from the
+// start of the file, and offsets of pages from the start of the data
+struct pageStoreHeader {
+    unsigned int magic;
+    unsigned int version;
+    unsigned int numPages;
+    unsigned int numSections;
+    unsigned int urlHashSize;
+    unsigned int pagesOffset;
+    unsigned int urlHashOffset;
+    unsigned int dataOffset;
+};
+
+// Where a section's text lies within its page's contents
+struct pageSpan {
+    unsigned int start;
+    unsigned int length;
+};
+
+// A stored page, with the span of each stored section. The modification
+// time of the page's file when it was packed, in nanoseconds, tells
+// whether the stored copy is still current
+struct storedPage {
+    unsigned long url;
+    unsigned long contents;
+    unsigned long modified;
+    unsigned int size;
+    struct pageSpan sections[STORED_SECTIONS];
+};
+
+// A memory-mapped page store
+struct _pageStore {
+    void *map;
+    size_t size;
+    struct pageStoreHeader *header;
+    struct storedPage *pages;
+    unsigned int *urlHash;
+    char *data;
+};
+
+void writePageStore(char *collection, char *output);
+pageStore openPageStore(char *filename);
+void closePageStore(pageStore store);
+int findStoredPage(pageStore store, char *url);
+char *getStoredUrl(pageStore store, int id);
+char *getStoredContents(pageStore store, int id);
+char *getStoredSection(pageStore store, int id, char *section, int *length);
+int isStoredPageCurrent(pageStore store, int id, struct stat *info);
+
+#endif
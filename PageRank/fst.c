@@ -0,0 +1,298 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fst.h"
+#include "postings.h"
+
+#define MAX_LABELS 256
+
+// A node on the path of the last term added, still open to new arcs. Every
+// arc but the last leads to a written node
+struct openNode {
+    int final;
+    int numArcs;
+    unsigned char labels[MAX_LABELS];
+    unsigned int targets[MAX_LABELS];
+    unsigned int counts[MAX_LABELS];    // Number of terms below each arc
+};
+
+// A written node, found by the hash of its contents so that equal nodes
+// are only written once
+struct registeredNode {
+    unsigned int hash;
+    unsigned int offset;
+    unsigned int count;     // Number of terms from the node on, zero if the slot is empty
+};
+
+// The nodes written so far and the open nodes of the last term
+struct fstBuilder {
+    unsigned char *out;
+    unsigned int size;
+    unsigned int capacity;
+    struct registeredNode *nodes;
+    unsigned int numNodes;
+    unsigned int tableSize;
+    struct openNode **path;
+    int pathSize;
+};
+
+static void addTerm(struct fstBuilder *b, char *prev, char *term, int first);
+static void closeNode(struct fstBuilder *b, int depth);
+static unsigned int writeNode(struct fstBuilder *b, struct openNode *node, unsigned int *count);
+static int sameNode(struct fstBuilder *b, unsigned int offset, struct openNode *node);
+static unsigned int hashNode(struct openNode *node);
+static void growTable(struct fstBuilder *b);
+static void reserve(struct fstBuilder *b, unsigned int length);
+static int followArc(unsigned char *fst, unsigned int *node, char label, unsigned int *output);
+static int countTerms(unsigned char *fst, unsigned int node);
+static int collate(char c);
+
+// Builds the transducer for terms given in collation order, with no term
+// given twice. Returns the encoded nodes, and sets size to their length in
+// bytes and root to the offset of the node every term starts from
+unsigned char *buildFst(char **terms, int numTerms, unsigned int *size, unsigned int *root) {
+    struct fstBuilder b;
+    b.capacity = 1024;
+    b.size = 0;
+    b.out = malloc(b.capacity);
+    b.numNodes = 0;
+    b.tableSize = 1024;
+    b.nodes = calloc(b.tableSize, sizeof(struct registeredNode));
+    b.pathSize = 1;
+    b.path = calloc(1, sizeof(struct openNode *));
+    b.path[0] = calloc(1, sizeof(struct openNode));
+
+    for (int t = 0; t < numTerms; t++) addTerm(&b, t > 0 ? terms[t - 1] : "", terms[t], t == 0);
+
+    // Write the last term's nodes, deepest first, then the root
+    int depth = numTerms > 0 ? strlen(terms[numTerms - 1]) : 0;
+    for (int d = depth; d > 0; d--) closeNode(&b, d);
+
+    unsigned int count;
+    *root = writeNode(&b, b.path[0], &count);
+    *size = b.size;
+
+    for (int d = 0; d < b.pathSize; d++) free(b.path[d]);
+    free(b.path);
+    free(b.nodes);
+    return b.out;
+}
+
+// Returns the number of a term, or -1 if it is not in the transducer
+int findFstTerm(unsigned char *fst, unsigned int root, char *term) {
+    unsigned int node = root;
+    unsigned int output = 0;
+
+    for (int i = 0; term[i] != '\0'; i++) {
+        if (!followArc(fst, &node, term[i], &output)) return -1;
+    }
+
+    unsigned char *in = fst + node;
+    if ((decodeVarint(&in) & 1) == 0) return -1;
+    return output;
+}
+
+// Finds the terms starting with a prefix, which are numbered consecutively.
+// Returns the number of the first and sets count to how many there are, or
+// returns -1 with a count of zero if there are none
+int findFstPrefix(unsigned char *fst, unsigned int root, char *prefix, int *count) {
+    unsigned int node = root;
+    unsigned int output = 0;
+    *count = 0;
+
+    for (int i = 0; prefix[i] != '\0'; i++) {
+        if (!followArc(fst, &node, prefix[i], &output)) return -1;
+    }
+
+    *count = countTerms(fst, node);
+    return *count > 0 ? (int)output : -1;
+}
+
+// Adds the next term in collation order. The nodes of the last term beyond
+// the prefix both share can no longer change, so they are written first
+static void addTerm(struct fstBuilder *b, char *prev, char *term, int first) {
+    int shared = 0;
+    while (prev[shared] != '\0' && prev[shared] == term[shared]) shared++;
+
+    int prevLength = strlen(prev);
+    int length = strlen(term);
+    int sorted = shared == prevLength ? length > shared :
+        shared < length && collate(prev[shared]) < collate(term[shared]);
+
+    if (!first && !sorted) {
+        printf("ERROR: Dictionary terms '%s' and '%s' are out of order\n", prev, term);
+        exit(1);
+    }
+
+    for (int d = prevLength; d > shared; d--) closeNode(b, d);
+
+    if (length + 1 > b->pathSize) {
+        b->path = realloc(b->path, (length + 1) * sizeof(struct openNode *));
+        for (int d = b->pathSize; d <= length; d++) b->path[d] = calloc(1, sizeof(struct openNode));
+        b->pathSize = length + 1;
+    }
+
+    for (int d = shared; d < length; d++) {
+        struct openNode *node = b->path[d];
+        node->labels[node->numArcs] = term[d];
+        node->numArcs++;
+
+        b->path[d + 1]->final = 0;
+        b->path[d + 1]->numArcs = 0;
+    }
+    b->path[length]->final = 1;
+}
+
+// Writes the open node at a depth, and points its parent's last arc at it
+static void closeNode(struct fstBuilder *b, int depth) {
+    struct openNode *parent = b->path[depth - 1];
+    int arc = parent->numArcs - 1;
+    parent->targets[arc] = writeNode(b, b->path[depth], &parent->counts[arc]);
+}
+
+// Writes a node unless an equal node has been written already, and returns
+// its offset. Sets count to the number of terms from the node on
+static unsigned int writeNode(struct fstBuilder *b, struct openNode *node, unsigned int *count) {
+    unsigned int hash = hashNode(node);
+    unsigned int mask = b->tableSize - 1;
+    unsigned int slot = hash & mask;
+
+    while (b->nodes[slot].count != 0) {
+        struct registeredNode *r = &b->nodes[slot];
+        if (r->hash == hash && sameNode(b, r->offset, node)) {
+            *count = r->count;
+            return r->offset;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    // Each arc's output is the number of terms ending before it
+    unsigned int offset = b->size;
+    unsigned int output = node->final;
+    reserve(b, MAX_VARINT + node->numArcs * (1 + 2 * MAX_VARINT));
+    b->size += encodeVarint((node->numArcs << 1) | node->final, b->out + b->size);
+
+    for (int i = 0; i < node->numArcs; i++) {
+        b->out[b->size] = node->labels[i];
+        b->size++;
+        b->size += encodeVarint(output, b->out + b->size);
+        b->size += encodeVarint(offset - node->targets[i], b->out + b->size);
+        output += node->counts[i];
+    }
+
+    b->nodes[slot].hash = hash;
+    b->nodes[slot].offset = offset;
+    b->nodes[slot].count = output;
+    b->numNodes++;
+    if (2 * b->numNodes > b->tableSize) growTable(b);
+
+    *count = output;
+    return offset;
+}
+
+// Returns whether a written node has the same ending and arcs as an open one
+static int sameNode(struct fstBuilder *b, unsigned int offset, struct openNode *node) {
+    unsigned char *in = b->out + offset;
+    unsigned int header = decodeVarint(&in);
+    if (header != (((unsigned int)node->numArcs << 1) | node->final)) return 0;
+
+    for (int i = 0; i < node->numArcs; i++) {
+        unsigned char label = *in;
+        in++;
+        decodeVarint(&in);
+        unsigned int target = offset - decodeVarint(&in);
+        if (label != node->labels[i] || target != node->targets[i]) return 0;
+    }
+
+    return 1;
+}
+
+// Hashes an open node from its ending and arcs
+static unsigned int hashNode(struct openNode *node) {
+    unsigned int hash = 2166136261u ^ node->final;
+    for (int i = 0; i < node->numArcs; i++) {
+        hash = (hash ^ node->labels[i]) * 16777619u;
+        hash = (hash ^ node->targets[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Doubles the table of written nodes
+static void growTable(struct fstBuilder *b) {
+    struct registeredNode *old = b->nodes;
+    unsigned int oldSize = b->tableSize;
+
+    b->tableSize *= 2;
+    b->nodes = calloc(b->tableSize, sizeof(struct registeredNode));
+    for (unsigned int i = 0; i < oldSize; i++) {
+        if (old[i].count == 0) continue;
+        unsigned int slot = old[i].hash & (b->tableSize - 1);
+        while (b->nodes[slot].count != 0) slot = (slot + 1) & (b->tableSize - 1);
+        b->nodes[slot] = old[i];
+    }
+    free(old);
+}
+
+// Makes room for length more bytes of output
+static void reserve(struct fstBuilder *b, unsigned int length) {
+    while (b->size + length > b->capacity) {
+        b->capacity *= 2;
+        b->out = realloc(b->out, b->capacity);
+    }
+}
+
+// Follows the arc with a label out of a node, adding its output. Returns
+// whether the node has such an arc
+static int followArc(unsigned char *fst, unsigned int *node, char label, unsigned int *output) {
+    unsigned char *in = fst + *node;
+    int numArcs = decodeVarint(&in) >> 1;
+
+    for (int i = 0; i < numArcs; i++) {
+        char arcLabel = *in;
+        in++;
+        unsigned int arcOutput = decodeVarint(&in);
+        unsigned int distance = decodeVarint(&in);
+
+        if (arcLabel == label) {
+            *node -= distance;
+            *output += arcOutput;
+            return 1;
+        }
+
+        // Arcs are in collation order, so the label cannot come later
+        if (collate(arcLabel) > collate(label)) return 0;
+    }
+
+    return 0;
+}
+
+// Returns the number of terms from a node on. The last arc's output counts
+// every term before it, so only the last arcs need following
+static int countTerms(unsigned char *fst, unsigned int node) {
+    int count = 0;
+
+    while (1) {
+        unsigned char *in = fst + node;
+        unsigned int header = decodeVarint(&in);
+        int numArcs = header >> 1;
+        if (numArcs == 0) return count + (header & 1);
+
+        unsigned int output = 0;
+        unsigned int distance = 0;
+        for (int i = 0; i < numArcs; i++) {
+            in++;
+            output = decodeVarint(&in);
+            distance = decodeVarint(&in);
+        }
+
+        count += output;
+        node -= distance;
+    }
+}
+
+// Returns the position of a character in collation order, which matches
+// newCollationKey for the lowercase terms of the dictionary
+static int collate(char c) {
+    return (unsigned char)c ^ 0x80;
+}
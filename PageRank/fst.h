@@ -0,0 +1,19 @@
+#ifndef FST_H
+#define FST_H
+
+// A finite-state transducer mapping each term of a sorted dictionary to its
+// position in the dictionary. It is a minimal acyclic automaton: terms that
+// end the same way share the nodes for their endings, so a large vocabulary
+// takes far less room than its strings. Each node is a varint holding its
+// number of arcs shifted left once, with the lowest bit set if a term ends
+// there, then each arc in collation order as a label byte, a varint output
+// and a varint distance back to the node it leads to. Nodes are written
+// after every node they lead to, and a term's number is the sum of the
+// outputs along its path
+
+unsigned char *buildFst(char **terms, int numTerms, unsigned int *size, unsigned int *root);
+
+int findFstTerm(unsigned char *fst, unsigned int root, char *term);
+int findFstPrefix(unsigned char *fst, unsigned int root, char *prefix, int *count);
+
+#endif
@@ -3,12 +3,16 @@
 #include <string.h>
 
 #include "graph.h"
+#include "text.h"
 
-// Initialises and returns a new graph object
+// Initialises and returns a new graph object, with room for size vertexes
+// before it needs to grow
 graph newGraph(int size) {
     graph g = malloc(sizeof(struct _graph));
-    g->vertexes = calloc(size, sizeof(struct _vertex));
+    if (size < 1) size = 1;
+    g->vertexes = calloc(size, sizeof(vertex));
     g->numVertexes = 0;
+    g->capacity = size;
     return g;
 }
 
@@ -71,6 +75,12 @@ void addVertex(graph g, char *id) {
         i++;
     }
 
+    // Double the vertex array when it is full
+    if (g->numVertexes == g->capacity) {
+        g->capacity *= 2;
+        g->vertexes = realloc(g->vertexes, g->capacity * sizeof(vertex));
+    }
+
     g->vertexes[i] = newVertex(id);
     g->vertexes[i]->num = g->numVertexes;
     g->numVertexes++;
@@ -107,6 +117,26 @@ void addConnection(graph g, char *src, char *dest) {
     addVertexEdge(v, dest);
 }
 
+// Adds a page as a vertex, if it is not one already, with a connection
+// to each other page its links text names. Connections only need their
+// source vertex to exist
+void addPageLinks(graph g, char *url, char *linksText) {
+    if (!vertexInGraph(g, url)) {
+        addVertex(g, url);
+    }
+
+    stringList links = splitString(linksText, " ");
+
+    // Add connection from URL to linked page
+    for (stringNode n = links->start; n != NULL; n = n->next) {
+        if (strcmp(url, n->string) != 0 && !isConnection(g, url, n->string)) {
+            addConnection(g, url, n->string);
+        }
+    }
+
+    freeStringList(links);
+}
+
 // Lists the edges contained in an edge list
 void listEdges(edgeList e) {
     for (edgeList curr = e; curr != NULL; curr = curr->next) {
@@ -8,6 +8,7 @@ typedef struct _edgeList *edgeList;
 struct _graph {
     vertex *vertexes;
     int numVertexes;
+    int capacity;
 };
 
 struct _vertex {
@@ -38,6 +39,7 @@ void addVertex(graph g, char *id);
 void addEdge(edgeList e, char *dest);
 void addVertexEdge(vertex v, char *dest);
 void addConnection(graph g, char *src, char *dest);
+void addPageLinks(graph g, char *url, char *linksText);
 
 void listEdges(edgeList e);
 void printGraph(graph g);
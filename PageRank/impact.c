@@ -0,0 +1,378 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "impact.h"
+
+#define NOT_IN_HEAP -1
+
+// Allows for rounding when comparing bounds worked out from impacts with
+// exact scores
+#define IMPACT_SLACK 1e-9
+
+// A document's impact for one term, while a term's postings are reordered
+struct impactPosting {
+    int impact;
+    int doc;
+};
+
+// A query term's impact-ordered postings, at the start of its next block.
+// impact is 0 once every block has been read
+struct impactCursor {
+    unsigned char *next;
+    int blocksLeft;
+    int impact;
+    int count;
+    double scale;
+};
+
+// The size best lower bounds on documents' ranking keys, lowest at the
+// root, with the position of each document in the heap. Bounds only grow,
+// so no document outside the heap has a bound above the root
+struct boundHeap {
+    int size;
+    int numDocs;
+    int *docs;
+    int *slots;         // Position of each document, or NOT_IN_HEAP
+    double *lower;      // Lower bound on each document's key
+};
+
+static double getTermContribution(forwardIndex forward, int doc, int term, double idf);
+static void writeImpactBlock(FILE *file, struct impactPosting *postings, int length,
+    int *ids, unsigned char *encoded);
+static int compareImpactPostings(const void *a, const void *b);
+static int compareDoublesDescending(const void *a, const void *b);
+static void readImpactBlock(struct impactCursor *c);
+static struct boundHeap newBoundHeap(int size, int numIds);
+static void raiseLowerBound(struct boundHeap *h, int doc, double amount);
+static void siftBoundDown(struct boundHeap *h, int i);
+static double getThreshold(struct boundHeap *h);
+static void freeBoundHeap(struct boundHeap *h);
+static struct rankedDoc rescoreDoc(query q, segment seg, int *indexTerms, double *idfs, int doc);
+
+// Writes an impact-ordered copy of a binary inverted index. Each posting
+// holds the tf * idf its term adds to the document's rank, quantised on a
+// scale of the term's own, so that its largest is IMPACT_LEVELS
+void buildImpactIndex(char *binaryInput, char *forwardInput, char *output) {
+    invertedIndex index = openIndex(binaryInput);
+    forwardIndex forward = index == NULL ? NULL : openForwardIndex(forwardInput);
+    if (forward == NULL) {
+        printf("%s\n", getIndexError());
+        exit(1);
+    }
+
+    int numDocs = index->header->numDocs;
+    int numTerms = index->header->numTerms;
+    int *ids = malloc((numDocs + 1) * sizeof(int));
+    double *contributions = malloc((numDocs + 1) * sizeof(double));
+
+    FILE *file = openReplacement(output);
+    if (file == NULL) {
+        printf("ERROR: Could not write index to file '%s'\n", output);
+        exit(1);
+    }
+
+    char *postings;
+    size_t postingsSize;
+    FILE *stream = open_memstream(&postings, &postingsSize);
+    struct impactTerm *terms = calloc(numTerms + 1, sizeof(struct impactTerm));
+    struct impactPosting *sorted = malloc((numDocs + 1) * sizeof(struct impactPosting));
+    unsigned char *encoded = malloc((numDocs + 1) * MAX_VARINT);
+
+    for (int t = 0; t < numTerms; t++) {
+        int length = readTermPostings(index, t, ids);
+        double idf = log((double)numDocs / length);
+
+        // The term's largest contribution sets the size of its levels
+        double largest = 0;
+        for (int i = 0; i < length; i++) {
+            contributions[i] = getTermContribution(forward, ids[i], t, idf);
+            if (contributions[i] > largest) largest = contributions[i];
+        }
+        terms[t].scale = largest / IMPACT_LEVELS;
+
+        for (int i = 0; i < length; i++) {
+            sorted[i].impact = quantiseImpact(contributions[i], terms[t].scale);
+            sorted[i].doc = ids[i];
+        }
+        qsort(sorted, length, sizeof(struct impactPosting), compareImpactPostings);
+
+        // Write one block for each run of documents sharing an impact
+        terms[t].postings = ftell(stream);
+        for (int i = 0; i < length; ) {
+            int end = i;
+            while (end < length && sorted[end].impact == sorted[i].impact) end++;
+            writeImpactBlock(stream, sorted + i, end - i, ids, encoded);
+            terms[t].numBlocks++;
+            i = end;
+        }
+    }
+    fclose(stream);
+
+    struct impactHeader header;
+    header.magic = IMPACT_MAGIC;
+    header.version = IMPACT_VERSION;
+    header.numDocs = numDocs;
+    header.numTerms = numTerms;
+    header.termsOffset = sizeof(struct impactHeader);
+    header.postingsOffset = header.termsOffset + numTerms * sizeof(struct impactTerm);
+
+    fwrite(&header, sizeof(struct impactHeader), 1, file);
+    fwrite(terms, sizeof(struct impactTerm), numTerms, file);
+    fwrite(postings, 1, postingsSize, file);
+    commitReplacement(file, output);
+
+    free(postings);
+    free(terms);
+    free(sorted);
+    free(encoded);
+    free(contributions);
+    free(ids);
+    closeForwardIndex(forward);
+    closeIndex(index);
+}
+
+// Returns the number of levels needed to cover a contribution, from 1 to
+// IMPACT_LEVELS. Rounding up means a contribution is above impact - 1
+// levels and at most impact levels
+int quantiseImpact(double contribution, double scale) {
+    if (scale <= 0) return 1;
+
+    double levels = ceil(contribution / scale);
+    if (levels < 1) return 1;
+    if (levels > IMPACT_LEVELS) return IMPACT_LEVELS;
+    return levels;
+}
+
+// Finds the size best documents for a query by tf-idf from an impact index,
+// given the idf of each query term. Blocks are read highest impact first
+// across every term. Each document found gets the exact count of its terms
+// plus bounds on its tf-idf either side of the quantised impacts. Reading
+// stops once the blocks left add up to less than the size-th best lower
+// bound, so no document not yet found can make the results. Every document
+// whose upper bound reaches that threshold is then scored exactly and
+// ranked as sortMatches ranks them, giving the same results. Impacts only
+// cover the base index, and a document must only contain one query word.
+// The query must have passed checkImpactQuery
+topDocs findTopImpact(query q, segmentSet set, impactIndex impacts, double *idfs, int size) {
+    segment seg = set->segments[0];
+    struct impactCursor *cursors = calloc(q->numTerms + 1, sizeof(struct impactCursor));
+    int *indexTerms = calloc(q->numTerms + 1, sizeof(int));
+    for (int t = 0; t < q->numTerms; t++) {
+        indexTerms[t] = findTerm(seg->index, q->terms[t]);
+        if (indexTerms[t] != NO_TERM) {
+            struct impactTerm *term = &impacts->terms[indexTerms[t]];
+            cursors[t].next = impacts->postings + term->postings;
+            cursors[t].blocksLeft = term->numBlocks;
+            cursors[t].scale = term->scale;
+        }
+        readImpactBlock(&cursors[t]);
+    }
+
+    // Upper bounds are kept as accumulator scores, with the exact counts
+    accumulators acc = newAccumulators(set->numIds);
+    struct boundHeap bounds = newBoundHeap(size, set->numIds);
+    int *docs = malloc((set->numIds + 1) * sizeof(int));
+
+    while (1) {
+        int best = NO_TERM;
+        double remaining = 0;
+        for (int t = 0; t < q->numTerms; t++) {
+            if (cursors[t].impact == 0) continue;
+            remaining += 1 + cursors[t].impact * cursors[t].scale;
+            if (best == NO_TERM || cursors[t].impact > cursors[best].impact) best = t;
+        }
+
+        if (best == NO_TERM || remaining + IMPACT_SLACK < getThreshold(&bounds)) break;
+
+        struct impactCursor *c = &cursors[best];
+        c->next = decodePostings(c->next, c->count, docs);
+        for (int i = 0; i < c->count; i++) {
+            addScore(acc, docs[i], c->impact * c->scale);
+            raiseLowerBound(&bounds, docs[i], 1 + (c->impact - 1) * c->scale);
+        }
+        readImpactBlock(c);
+    }
+
+    // A document can only gain from the terms it was not found in, so at
+    // most the largest of what each term left could add
+    double *left = calloc(q->numTerms + 1, sizeof(double));
+    for (int t = 0; t < q->numTerms; t++) {
+        left[t + 1] = cursors[t].impact == 0 ? 0 : 1 + cursors[t].impact * cursors[t].scale;
+    }
+    qsort(left + 1, q->numTerms, sizeof(double), compareDoublesDescending);
+    for (int t = 1; t <= q->numTerms; t++) left[t] += left[t - 1];
+
+    // Any document that might still reach the threshold is scored exactly
+    double threshold = getThreshold(&bounds);
+    topDocs top = newTopDocs(size);
+    for (int i = 0; i < acc->numTouched; i++) {
+        int doc = acc->touched[i];
+        double upper = acc->counts[doc] + acc->scores[doc] + left[q->numTerms - acc->counts[doc]];
+        if (upper + IMPACT_SLACK >= threshold) offerTopDoc(top, rescoreDoc(q, seg, indexTerms, idfs, doc));
+    }
+    sortTopDocs(top);
+
+    freeBoundHeap(&bounds);
+    freeAccumulators(acc);
+    free(left);
+    free(docs);
+    free(indexTerms);
+    free(cursors);
+    return top;
+}
+
+// Returns why a query cannot be answered from an impact index, or NULL if
+// it can
+char *checkImpactQuery(query q, segmentSet set, impactIndex impacts) {
+    if (set->numSegments != 1) {
+        return "ERROR: -impact cannot search pages added since the last inverted -i";
+    }
+
+    if (q->numWords != q->numTerms || q->found != NULL) {
+        return "ERROR: -impact only supports words, any of which may match";
+    }
+
+    invertedIndex index = set->segments[0]->index;
+    if (impacts->header->numDocs != index->header->numDocs ||
+        impacts->header->numTerms != index->header->numTerms) {
+        return "ERROR: The impact index does not match the inverted index";
+    }
+
+    return NULL;
+}
+
+// Returns the tf-idf a term adds to the rank of a document containing it
+static double getTermContribution(forwardIndex forward, int doc, int term, double idf) {
+    return calculateTf(forward, doc, term) * idf;
+}
+
+// Writes the documents sharing an impact as one block, in ID order
+static void writeImpactBlock(FILE *file, struct impactPosting *postings, int length,
+    int *ids, unsigned char *encoded) {
+    for (int i = 0; i < length; i++) ids[i] = postings[i].doc;
+
+    int size = encodeVarint(postings[0].impact, encoded);
+    size += encodeVarint(length, encoded + size);
+    size += encodePostings(ids, length, encoded + size);
+    fwrite(encoded, 1, size, file);
+}
+
+// Compares postings by impact descending, then by document ascending
+static int compareImpactPostings(const void *a, const void *b) {
+    const struct impactPosting *first = a;
+    const struct impactPosting *second = b;
+
+    if (first->impact != second->impact) return second->impact - first->impact;
+    return first->doc - second->doc;
+}
+
+static int compareDoublesDescending(const void *a, const void *b) {
+    double first = *(const double *)a;
+    double second = *(const double *)b;
+    return (first < second) - (first > second);
+}
+
+// Reads the impact and size of a cursor's next block
+static void readImpactBlock(struct impactCursor *c) {
+    if (c->blocksLeft == 0) {
+        c->impact = 0;
+        c->count = 0;
+        return;
+    }
+
+    c->impact = decodeVarint(&c->next);
+    c->count = decodeVarint(&c->next);
+    c->blocksLeft--;
+}
+
+// Allocates a heap for the lower bounds of the size best documents among
+// numIds, with every bound zero
+static struct boundHeap newBoundHeap(int size, int numIds) {
+    struct boundHeap h;
+    h.size = size;
+    h.numDocs = 0;
+    h.docs = malloc((size + 1) * sizeof(int));
+    h.slots = malloc((numIds + 1) * sizeof(int));
+    h.lower = calloc(numIds + 1, sizeof(double));
+    for (int i = 0; i < numIds; i++) h.slots[i] = NOT_IN_HEAP;
+    return h;
+}
+
+// Raises the lower bound of a document, keeping the size best in the heap
+static void raiseLowerBound(struct boundHeap *h, int doc, double amount) {
+    h->lower[doc] += amount;
+
+    if (h->slots[doc] != NOT_IN_HEAP) {
+        siftBoundDown(h, h->slots[doc]);
+    } else if (h->numDocs < h->size) {
+        // Add the document at the bottom, and move it up above higher bounds
+        int i = h->numDocs;
+        h->numDocs++;
+        while (i > 0 && h->lower[h->docs[(i - 1) / 2]] > h->lower[doc]) {
+            h->docs[i] = h->docs[(i - 1) / 2];
+            h->slots[h->docs[i]] = i;
+            i = (i - 1) / 2;
+        }
+        h->docs[i] = doc;
+        h->slots[doc] = i;
+    } else if (h->size > 0 && h->lower[doc] > h->lower[h->docs[0]]) {
+        // Replace the lowest of the best
+        h->slots[h->docs[0]] = NOT_IN_HEAP;
+        h->docs[0] = doc;
+        h->slots[doc] = 0;
+        siftBoundDown(h, 0);
+    }
+}
+
+// Moves a document whose bound has grown down below lower bounds
+static void siftBoundDown(struct boundHeap *h, int i) {
+    int doc = h->docs[i];
+
+    while (1) {
+        int child = 2 * i + 1;
+        if (child >= h->numDocs) break;
+        if (child + 1 < h->numDocs && h->lower[h->docs[child + 1]] < h->lower[h->docs[child]]) child++;
+        if (h->lower[h->docs[child]] >= h->lower[doc]) break;
+        h->docs[i] = h->docs[child];
+        h->slots[h->docs[i]] = i;
+        i = child;
+    }
+
+    h->docs[i] = doc;
+    h->slots[doc] = i;
+}
+
+// Returns the size-th best lower bound, which the results are known to
+// reach, or 0 while fewer documents have been found
+static double getThreshold(struct boundHeap *h) {
+    if (h->size == 0 || h->numDocs < h->size) return 0;
+    return h->lower[h->docs[0]];
+}
+
+// Frees the memory occupied by a heap of lower bounds
+static void freeBoundHeap(struct boundHeap *h) {
+    free(h->docs);
+    free(h->slots);
+    free(h->lower);
+}
+
+// Scores a document exactly from every query word it contains, adding
+// terms in query order as the exhaustive scorer does
+static struct rankedDoc rescoreDoc(query q, segment seg, int *indexTerms, double *idfs, int doc) {
+    double score = 0;
+    int count = 0;
+
+    for (int t = 0; t < q->numTerms; t++) {
+        if (indexTerms[t] == NO_TERM || getTermCount(seg->forward, doc, indexTerms[t]) == 0) continue;
+        score += calculateTf(seg->forward, doc, indexTerms[t]) * idfs[t];
+        count++;
+    }
+
+    struct rankedDoc ranked;
+    ranked.key = count + score;
+    ranked.score = score;
+    ranked.id = doc;
+    ranked.url = getDocUrl(seg->index, doc);
+    return ranked;
+}
@@ -0,0 +1,13 @@
+#ifndef IMPACT_H
+#define IMPACT_H
+
+#include "search.h"
+#include "topk.h"
+
+void buildImpactIndex(char *binaryIndex, char *forwardIndex, char *output);
+int quantiseImpact(double contribution, double scale);
+
+char *checkImpactQuery(query q, segmentSet set, impactIndex impacts);
+topDocs findTopImpact(query q, segmentSet set, impactIndex impacts, double *idfs, int size);
+
+#endif
@@ -0,0 +1,363 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "index.h"
+#include "postings.h"
+#include "fst.h"
+#include "bloom.h"
+#include "text.h"
+
+// Why the last index file could not be opened. Indexes are only opened by
+// one thread at a time, so a single message is kept
+static char indexError[MAX_LINE];
+
+static void *mapIndexFile(char *filename, size_t headerSize, unsigned int magic,
+    unsigned int version, char *kind, size_t *size);
+
+// FNV-1a hash of a term
+unsigned int hashTerm(char *term) {
+    unsigned int hash = 2166136261u;
+    for (int i = 0; term[i] != '\0'; i++) {
+        hash ^= (unsigned char)term[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Returns the term frequency count / length rounded up to a float, so that
+// it is never below the exact value
+float boundTf(int count, int length) {
+    double tf = (double)count / length;
+    float bound = tf;
+    if (bound < tf) bound = nextafterf(bound, INFINITY);
+    return bound;
+}
+
+// Returns the number of blocks of postings, each with its own bound, that a
+// term of the given document frequency has
+int countBlocks(int docFreq) {
+    return (docFreq + SKIP_INTERVAL - 1) / SKIP_INTERVAL;
+}
+
+// Writes the bound on the term frequency of each block of a term's postings,
+// from the number of times it appears in each document and the documents'
+// lengths. Returns the bound over every block
+float writeTermBounds(FILE *file, int *ids, int *freqs, int *docLengths, int length) {
+    float maxTf = 0;
+
+    for (int block = 0; block < countBlocks(length); block++) {
+        float blockTf = 0;
+        for (int i = block * SKIP_INTERVAL; i < length && i < (block + 1) * SKIP_INTERVAL; i++) {
+            float tf = boundTf(freqs[i], docLengths[ids[i]]);
+            if (tf > blockTf) blockTf = tf;
+        }
+
+        fwrite(&blockTf, sizeof(float), 1, file);
+        if (blockTf > maxTf) maxTf = blockTf;
+    }
+
+    return maxTf;
+}
+
+// Maps a binary inverted index file into memory. Returns NULL if it cannot
+// be opened, with the reason given by getIndexError
+invertedIndex openIndex(char *filename) {
+    size_t size;
+    void *map = mapIndexFile(filename, sizeof(struct indexHeader), INDEX_MAGIC, INDEX_VERSION,
+        "inverted", &size);
+    struct indexHeader *header = map;
+    if (map == NULL) return NULL;
+
+    invertedIndex index = malloc(sizeof(struct _invertedIndex));
+    index->map = map;
+    index->size = size;
+    index->header = header;
+    index->bloom = (unsigned char *)map + header->bloomOffset;
+    index->docs = (struct indexDoc *)((char *)map + header->docsOffset);
+    index->terms = (struct indexTerm *)((char *)map + header->termsOffset);
+    index->docHash = (unsigned int *)((char *)map + header->docHashOffset);
+    index->bounds = (float *)((char *)map + header->boundsOffset);
+    index->fst = (unsigned char *)map + header->fstOffset;
+    index->strings = (char *)map + header->stringsOffset;
+    index->postings = (unsigned char *)map + header->postingsOffset;
+    return index;
+}
+
+// Unmaps an inverted index and frees its memory
+void closeIndex(invertedIndex index) {
+    if (index == NULL) return;
+    munmap(index->map, index->size);
+    free(index);
+}
+
+// Returns the number of a term in the dictionary, or NO_TERM if the term
+// is not indexed. Most terms that are not indexed never reach the FST
+int findTerm(invertedIndex index, char *term) {
+    if (!bloomMayContain(index->bloom, index->header->bloomBlocks, term)) return NO_TERM;
+
+    int t = findFstTerm(index->fst, index->header->fstRoot, term);
+    return t < 0 ? NO_TERM : t;
+}
+
+// Returns the number of the first term starting with a prefix, and sets
+// count to how many do. They are numbered consecutively, so every match is
+// found without looking at the rest of the dictionary
+int findPrefixTerms(invertedIndex index, char *prefix, int *count) {
+    int t = findFstPrefix(index->fst, index->header->fstRoot, prefix, count);
+    return t < 0 ? NO_TERM : t;
+}
+
+// Returns the ID of the document with the given URL, or NO_DOC if the URL
+// is not in the index
+int findDoc(invertedIndex index, char *url) {
+    unsigned int mask = index->header->docHashSize - 1;
+    unsigned int slot = hashTerm(url) & mask;
+
+    while (index->docHash[slot] != 0) {
+        int doc = index->docHash[slot] - 1;
+        if (strcmp(getDocUrl(index, doc), url) == 0) return doc;
+        slot = (slot + 1) & mask;
+    }
+
+    return NO_DOC;
+}
+
+// Returns the string of a term in the dictionary
+char *getTermName(invertedIndex index, int term) {
+    return index->strings + index->terms[term].name;
+}
+
+// Returns the URL of a document
+char *getDocUrl(invertedIndex index, int doc) {
+    return index->strings + index->docs[doc].url;
+}
+
+// Decodes the postings of a term into an array of document IDs, which
+// needs room for the term's document frequency. Returns the number of IDs
+int readTermPostings(invertedIndex index, int term, int *ids) {
+    struct indexTerm *t = &index->terms[term];
+    decodePostings(getPostingGaps(index->postings + t->postings, t->docFreq), t->docFreq, ids);
+    return t->docFreq;
+}
+
+// Places a cursor before the first posting of a term
+void openTermCursor(invertedIndex index, int term, struct postingCursor *cursor) {
+    struct indexTerm *t = &index->terms[term];
+    openCursor(cursor, index->postings + t->postings, t->docFreq);
+}
+
+// Returns the bound on the term frequency of a block of a term's postings
+float getBlockBound(invertedIndex index, int term, int block) {
+    return index->bounds[index->terms[term].bounds + block];
+}
+
+// Maps a forward index file into memory. Returns NULL if it cannot be
+// opened, with the reason given by getIndexError
+forwardIndex openForwardIndex(char *filename) {
+    size_t size;
+    void *map = mapIndexFile(filename, sizeof(struct forwardHeader), FORWARD_MAGIC,
+        FORWARD_VERSION, "forward", &size);
+    struct forwardHeader *header = map;
+    if (map == NULL) return NULL;
+
+    forwardIndex index = malloc(sizeof(struct _forwardIndex));
+    index->map = map;
+    index->size = size;
+    index->header = header;
+    index->docs = (struct forwardDoc *)((char *)map + header->docsOffset);
+    index->entries = (struct forwardEntry *)((char *)map + header->entriesOffset);
+    return index;
+}
+
+// Unmaps a forward index and frees its memory
+void closeForwardIndex(forwardIndex index) {
+    if (index == NULL) return;
+    munmap(index->map, index->size);
+    free(index);
+}
+
+// Returns the number of words in a document
+int getDocLength(forwardIndex index, int doc) {
+    return index->docs[doc].length;
+}
+
+// Returns the number of times a term appears in a document
+int getTermCount(forwardIndex index, int doc, int term) {
+    struct forwardEntry *entries = index->entries + index->docs[doc].entries;
+    int low = 0;
+    int high = index->docs[doc].numTerms;
+
+    // Binary search the document's terms, which are in ascending order
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if ((int)entries[mid].term < term) low = mid + 1;
+        else high = mid;
+    }
+
+    if (low < (int)index->docs[doc].numTerms && (int)entries[low].term == term) {
+        return entries[low].count;
+    }
+
+    return 0;
+}
+
+// Maps a positional index file into memory. Returns NULL if it cannot be
+// opened, or was not built with the inverted index given, as a positional
+// index left from an earlier build would match phrases against the wrong
+// documents
+positionalIndex openPositionalIndex(char *filename, invertedIndex inverted) {
+    size_t size;
+    void *map = mapIndexFile(filename, sizeof(struct positionalHeader), POSITIONAL_MAGIC,
+        POSITIONAL_VERSION, "positional", &size);
+    struct positionalHeader *header = map;
+    if (map == NULL) return NULL;
+
+    // Every term must appear in as many documents as the inverted index says
+    int matches = header->indexDocs == inverted->header->numDocs &&
+        header->numTerms == inverted->header->numTerms;
+    struct positionalTerm *terms = (struct positionalTerm *)((char *)map + header->termsOffset);
+    for (unsigned int t = 0; matches && t < header->numTerms; t++) {
+        matches = terms[t].docFreq == inverted->terms[t].docFreq;
+    }
+
+    if (!matches) {
+        munmap(map, size);
+        return NULL;
+    }
+
+    positionalIndex index = malloc(sizeof(struct _positionalIndex));
+    index->map = map;
+    index->size = size;
+    index->header = header;
+    index->terms = (struct positionalTerm *)((char *)map + header->termsOffset);
+    index->docs = (struct positionalDoc *)((char *)map + header->docsOffset);
+    index->positions = (unsigned char *)map + header->positionsOffset;
+    return index;
+}
+
+// Unmaps a positional index and frees its memory
+void closePositionalIndex(positionalIndex index) {
+    if (index == NULL) return;
+    munmap(index->map, index->size);
+    free(index);
+}
+
+// Maps an impact-ordered index file into memory. Returns NULL if it cannot
+// be opened, with the reason given by getIndexError
+impactIndex openImpactIndex(char *filename) {
+    size_t size;
+    void *map = mapIndexFile(filename, sizeof(struct impactHeader), IMPACT_MAGIC, IMPACT_VERSION,
+        "impact", &size);
+    struct impactHeader *header = map;
+    if (map == NULL) return NULL;
+
+    impactIndex index = malloc(sizeof(struct _impactIndex));
+    index->map = map;
+    index->size = size;
+    index->header = header;
+    index->terms = (struct impactTerm *)((char *)map + header->termsOffset);
+    index->postings = (unsigned char *)map + header->postingsOffset;
+    return index;
+}
+
+// Unmaps an impact-ordered index and frees its memory
+void closeImpactIndex(impactIndex index) {
+    if (index == NULL) return;
+    munmap(index->map, index->size);
+    free(index);
+}
+
+// Decodes the word positions of a document entry into an array, and
+// returns the number of positions
+int readPositions(positionalIndex index, int entry, int *positions) {
+    unsigned char *in = index->positions + index->docs[entry].positions;
+    int count = decodeVarint(&in);
+    decodePostings(in, count, positions);
+    return count;
+}
+
+// Returns the number of positions stored for a document entry
+int countPositions(positionalIndex index, int entry) {
+    unsigned char *in = index->positions + index->docs[entry].positions;
+    return decodeVarint(&in);
+}
+
+// Opens a temporary file to write a file that readers map, or returns NULL
+// if it cannot be created. A mapped file is never rewritten in place, as
+// readers would see it half written, or fault on pages it no longer has
+FILE *openReplacement(char *filename) {
+    char *temporary = stringJoin(filename, ".tmp");
+    FILE *file = fopen(temporary, "wb");
+    free(temporary);
+    return file;
+}
+
+// Closes a file opened by openReplacement and renames it into place, so
+// readers see either the old file or the whole of the new one
+void commitReplacement(FILE *file, char *filename) {
+    char *temporary = stringJoin(filename, ".tmp");
+
+    if (fclose(file) != 0 || rename(temporary, filename) != 0) {
+        printf("ERROR: Could not write index to file '%s'\n", filename);
+        exit(1);
+    }
+
+    free(temporary);
+}
+
+// Maps a whole file into memory read-only, and returns NULL if it cannot
+// be opened or mapped or is smaller than minSize
+void *mapFile(char *filename, size_t minSize, size_t *size) {
+    int fd = open(filename, O_RDONLY);
+    struct stat info;
+
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        if (fd >= 0) close(fd);
+        *size = 0;
+        return NULL;
+    }
+
+    void *map = NULL;
+    if ((size_t)info.st_size >= minSize && info.st_size > 0) {
+        map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) map = NULL;
+    }
+    close(fd);
+
+    *size = info.st_size;
+    return map;
+}
+
+// Returns why the last index file that failed to open could not be opened
+char *getIndexError() {
+    return indexError;
+}
+
+// Maps an index file whose header starts with the magic number and version
+// given. Returns NULL, and notes why for getIndexError, if it cannot be
+// opened or is not that kind of index
+static void *mapIndexFile(char *filename, size_t headerSize, unsigned int magic,
+    unsigned int version, char *kind, size_t *size) {
+    void *map = mapFile(filename, headerSize, size);
+    unsigned int *header = map;
+
+    if (map == NULL && *size == 0) {
+        snprintf(indexError, sizeof(indexError), "ERROR: Could not read index file '%s'", filename);
+        return NULL;
+    }
+
+    if (map == NULL || header[0] != magic || header[1] != version) {
+        if (map != NULL) munmap(map, *size);
+        snprintf(indexError, sizeof(indexError), "ERROR: '%s' is not a version %u %s index",
+            filename, version, kind);
+        return NULL;
+    }
+
+    return map;
+}
@@ -0,0 +1,228 @@
+#ifndef INDEX_H
+#define INDEX_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "postings.h"
+
+#define INDEX_MAGIC 0x58444950
+#define INDEX_VERSION 7
+#define FORWARD_MAGIC 0x44575746
+#define FORWARD_VERSION 1
+#define POSITIONAL_MAGIC 0x534F5050
+#define POSITIONAL_VERSION 2
+#define IMPACT_MAGIC 0x54434D49
+#define IMPACT_VERSION 2
+
+// Number of levels an impact score is quantised to
+#define IMPACT_LEVELS 255
+
+#define NO_TERM -1
+#define NO_DOC -1
+
+typedef struct _invertedIndex *invertedIndex;
+typedef struct _forwardIndex *forwardIndex;
+typedef struct _positionalIndex *positionalIndex;
+typedef struct _impactIndex *impactIndex;
+
+// Binary inverted index layout. Every offset is in bytes from the start of
+// the file, except string, postings and FST root offsets, which are from
+// the start of their own region. The Bloom filter over the terms comes
+// first, aligned so that each of its blocks is one cache line
+struct indexHeader {
+    unsigned int magic;
+    unsigned int version;
+    unsigned int numDocs;
+    unsigned int numTerms;
+    unsigned int docHashSize;
+    unsigned int fstRoot;
+    unsigned int bloomBlocks;
+    unsigned int bloomOffset;
+    unsigned int docsOffset;
+    unsigned int termsOffset;
+    unsigned int docHashOffset;
+    unsigned int boundsOffset;
+    unsigned int fstOffset;
+    unsigned int stringsOffset;
+    unsigned int postingsOffset;
+};
+
+// A document, with its position when documents are sorted by URL
+struct indexDoc {
+    unsigned int url;
+    unsigned int rank;
+};
+
+// A term of the dictionary. Terms are stored in sorted order, and their
+// postings are a table of skip pointers then varint gaps between ascending
+// document IDs, as written by encodeSkipPostings. Each block of postings
+// between skip pointers has an upper bound on the term frequency of its
+// documents, starting at the term's first bound, and maxTf bounds them all
+struct indexTerm {
+    unsigned int name;
+    unsigned int docFreq;
+    unsigned int postings;
+    unsigned int postingsSize;
+    unsigned int bounds;
+    float maxTf;
+};
+
+// A memory-mapped binary inverted index. The hash table maps URL hashes to
+// document numbers plus one, with zero marking an empty slot, and the FST
+// maps terms to term numbers. The Bloom filter rules out most terms that
+// are not in the dictionary before the FST is walked
+struct _invertedIndex {
+    void *map;
+    size_t size;
+    struct indexHeader *header;
+    unsigned char *bloom;
+    struct indexDoc *docs;
+    struct indexTerm *terms;
+    unsigned int *docHash;
+    float *bounds;
+    unsigned char *fst;
+    char *strings;
+    unsigned char *postings;
+};
+
+// Forward index layout. Each document lists the terms it contains, by their
+// number in the inverted index, in ascending order
+struct forwardHeader {
+    unsigned int magic;
+    unsigned int version;
+    unsigned int numDocs;
+    unsigned int numEntries;
+    unsigned int docsOffset;
+    unsigned int entriesOffset;
+};
+
+// A document's number of words, and where its term entries start
+struct forwardDoc {
+    unsigned int length;
+    unsigned int numTerms;
+    unsigned int entries;
+};
+
+// The number of times a term appears in a document
+struct forwardEntry {
+    unsigned int term;
+    unsigned int count;
+};
+
+// A memory-mapped forward index
+struct _forwardIndex {
+    void *map;
+    size_t size;
+    struct forwardHeader *header;
+    struct forwardDoc *docs;
+    struct forwardEntry *entries;
+};
+
+// Positional index layout. Terms are numbered as in the inverted index, and
+// each has a run of document entries in ascending document order. Document
+// entries are fixed width so they can be searched without decoding. The
+// number of documents in the inverted index ties the file to that index
+struct positionalHeader {
+    unsigned int magic;
+    unsigned int version;
+    unsigned int numTerms;
+    unsigned int numDocs;
+    unsigned int indexDocs;
+    unsigned int termsOffset;
+    unsigned int docsOffset;
+    unsigned int positionsOffset;
+};
+
+// Where a term's document entries start, and how many there are
+struct positionalTerm {
+    unsigned int docs;
+    unsigned int docFreq;
+};
+
+// A document containing a term. Its positions, from the start of the
+// positions region, are a varint count followed by varint gaps between
+// ascending word positions in Section-2
+struct positionalDoc {
+    unsigned int doc;
+    unsigned int positions;
+};
+
+// A memory-mapped positional index
+struct _positionalIndex {
+    void *map;
+    size_t size;
+    struct positionalHeader *header;
+    struct positionalTerm *terms;
+    struct positionalDoc *docs;
+    unsigned char *positions;
+};
+
+// Impact-ordered index layout. Terms are numbered as in the inverted index.
+// Each posting's impact is the tf-idf its term adds to the document's rank,
+// rounded up to a whole number of steps of the term's scale
+struct impactHeader {
+    unsigned int magic;
+    unsigned int version;
+    unsigned int numDocs;
+    unsigned int numTerms;
+    unsigned int termsOffset;
+    unsigned int postingsOffset;
+};
+
+// Where a term's postings start, from the start of the postings region.
+// They are blocks of documents sharing one impact, highest impact first,
+// each a varint impact and count then varint gaps between ascending
+// document IDs
+struct impactTerm {
+    unsigned int postings;
+    unsigned int numBlocks;
+    double scale;
+};
+
+// A memory-mapped impact-ordered index
+struct _impactIndex {
+    void *map;
+    size_t size;
+    struct impactHeader *header;
+    struct impactTerm *terms;
+    unsigned char *postings;
+};
+
+unsigned int hashTerm(char *term);
+void *mapFile(char *filename, size_t minSize, size_t *size);
+char *getIndexError();
+FILE *openReplacement(char *filename);
+void commitReplacement(FILE *file, char *filename);
+float boundTf(int count, int length);
+int countBlocks(int docFreq);
+float writeTermBounds(FILE *file, int *ids, int *freqs, int *docLengths, int length);
+
+invertedIndex openIndex(char *filename);
+void closeIndex(invertedIndex index);
+
+int findTerm(invertedIndex index, char *term);
+int findPrefixTerms(invertedIndex index, char *prefix, int *count);
+int findDoc(invertedIndex index, char *url);
+char *getTermName(invertedIndex index, int term);
+char *getDocUrl(invertedIndex index, int doc);
+int readTermPostings(invertedIndex index, int term, int *ids);
+void openTermCursor(invertedIndex index, int term, struct postingCursor *cursor);
+float getBlockBound(invertedIndex index, int term, int block);
+
+forwardIndex openForwardIndex(char *filename);
+void closeForwardIndex(forwardIndex index);
+
+int getDocLength(forwardIndex index, int doc);
+int getTermCount(forwardIndex index, int doc, int term);
+
+positionalIndex openPositionalIndex(char *filename, invertedIndex index);
+void closePositionalIndex(positionalIndex index);
+
+int countPositions(positionalIndex index, int entry);
+int readPositions(positionalIndex index, int entry, int *positions);
+
+impactIndex openImpactIndex(char *filename);
+void closeImpactIndex(impactIndex index);
+
+#endif
@@ -0,0 +1,802 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "indexer.h"
+#include "index.h"
+#include "postings.h"
+#include "fst.h"
+#include "bloom.h"
+#include "loader.h"
+
+// Indexes one range of documents into its own term run
+struct mapTask {
+    docTable docs;
+    int start;
+    int end;
+    int positional;
+    linkTable links;
+    termRun run;
+};
+
+// Merges the terms in [low, high) from every run into a buffer of text
+// index lines and a buffer of postings. A NULL bound leaves that end of the
+// range open. Term postings offsets are from the start of the task's buffer.
+// Every posting is also kept with its frequency, in term order, to build
+// the forward index from. For a positional index, each posting's positions
+// are written to a buffer of their own, at the offset kept for the posting
+struct mergeTask {
+    docTable docs;
+    termRun *runs;
+    int numRuns;
+    stringBST low;
+    stringBST high;
+    int numTerms;
+    char **names;
+    struct indexTerm *terms;
+    char *text;
+    size_t textSize;
+    char *postings;
+    size_t postingsSize;
+    char *bounds;
+    size_t boundsSize;
+    long numPostings;
+    int *postingDocs;
+    int *postingFreqs;
+    int positional;
+    char *positions;
+    size_t positionsSize;
+    unsigned int *postingPositions;
+};
+
+// A URL waiting to be given a document ID
+struct urlEntry {
+    char *url;
+    collationKey collation;
+    int index;
+};
+
+static void runTasks(void *(*function)(void *), void *tasks, size_t taskSize, int numTasks);
+static void *mapDocs(void *arg);
+static void *mergeRuns(void *arg);
+static int compareTermPointers(const void *a, const void *b);
+static int compareUrlEntries(const void *a, const void *b);
+static int compareInts(const void *a, const void *b);
+static int lowerBound(termRun run, stringBST term);
+static struct forwardEntry *collectForwardEntries(docTable docs, struct mergeTask *merges,
+    int numMerges, struct forwardDoc *docEntries, long *numEntries);
+static void writePositions(FILE *file, int *positions, int count);
+static void writePositionalIndex(FILE *file, docTable docs, struct mergeTask *merges, int numMerges);
+
+// Returns the number of threads to use when none are given
+int defaultThreads() {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores < 1) return 1;
+    return cores;
+}
+
+// Builds an inverted index of the pages in a collection, and writes it both
+// as text and in the binary format read by openIndex, along with a forward
+// index of each document's terms. If positionalOutput is not NULL, the word
+// positions of every term are also written there
+void buildInvertedIndex(char *collection, char *textOutput, char *binaryOutput,
+    char *forwardOutput, char *positionalOutput, int numThreads) {
+    docTable docs = readDocTable(collection);
+    buildIndex(docs, textOutput, binaryOutput, forwardOutput, positionalOutput, numThreads, NULL);
+    freeDocTable(docs);
+}
+
+// Indexes the pages of a document table and writes the index files. Each
+// thread indexes a separate range of documents into its own run of terms.
+// If links is not NULL, each page's Section-1 links are put in it as the
+// page is read
+void buildIndex(docTable docs, char *textOutput, char *binaryOutput,
+    char *forwardOutput, char *positionalOutput, int numThreads, linkTable links) {
+    if (numThreads > docs->numDocs) numThreads = docs->numDocs;
+    if (numThreads < 1) numThreads = 1;
+
+    // Map each range of documents to a sorted run of terms
+    struct mapTask *maps = calloc(numThreads, sizeof(struct mapTask));
+    for (int i = 0; i < numThreads; i++) {
+        maps[i].docs = docs;
+        maps[i].start = (long)docs->numDocs * i / numThreads;
+        maps[i].end = (long)docs->numDocs * (i + 1) / numThreads;
+        maps[i].positional = positionalOutput != NULL;
+        maps[i].links = links;
+    }
+
+    runTasks(mapDocs, maps, sizeof(struct mapTask), numThreads);
+
+    termRun *runs = calloc(numThreads, sizeof(termRun));
+    for (int i = 0; i < numThreads; i++) runs[i] = maps[i].run;
+
+    writeRuns(docs, runs, numThreads, textOutput, binaryOutput, forwardOutput,
+        positionalOutput, numThreads);
+
+    for (int i = 0; i < numThreads; i++) freeTermRun(runs[i]);
+    free(runs);
+    free(maps);
+}
+
+// Merges runs of terms and writes the index files. Runs must cover
+// ascending ranges of document IDs. The text index is skipped if textOutput
+// is NULL, and the positional index if positionalOutput is NULL. Each thread
+// merges a separate range of terms, so the output is the same for any
+// number of threads
+void writeRuns(docTable docs, termRun *runs, int numRuns, char *textOutput,
+    char *binaryOutput, char *forwardOutput, char *positionalOutput, int numThreads) {
+    int positional = positionalOutput != NULL;
+
+    termRun largest = NULL;
+    for (int i = 0; i < numRuns; i++) {
+        if (largest == NULL || runs[i]->numTerms > largest->numTerms) largest = runs[i];
+    }
+
+    // Every range but the first starts at a term of the largest run
+    if (largest != NULL && numThreads > largest->numTerms) numThreads = largest->numTerms;
+    if (numThreads < 1) numThreads = 1;
+
+    // Split the terms into ranges at evenly spaced terms of the largest run,
+    // and merge each range from every run
+    struct mergeTask *merges = calloc(numThreads, sizeof(struct mergeTask));
+    for (int i = 0; i < numThreads; i++) {
+        merges[i].docs = docs;
+        merges[i].runs = runs;
+        merges[i].numRuns = numRuns;
+        merges[i].low = NULL;
+        merges[i].high = NULL;
+        merges[i].positional = positional;
+
+        if (i > 0) {
+            merges[i].low = largest->terms[(long)largest->numTerms * i / numThreads];
+        }
+        if (i < numThreads - 1) {
+            merges[i].high = largest->terms[(long)largest->numTerms * (i + 1) / numThreads];
+        }
+    }
+
+    runTasks(mergeRuns, merges, sizeof(struct mergeTask), numThreads);
+
+    FILE *text = textOutput != NULL ? fopen(textOutput, "w") : NULL;
+    FILE *binary = openReplacement(binaryOutput);
+    FILE *forward = openReplacement(forwardOutput);
+    FILE *positions = positional ? openReplacement(positionalOutput) : NULL;
+
+    if ((textOutput != NULL && text == NULL) || binary == NULL || forward == NULL ||
+        (positional && positions == NULL)) {
+        char *failed = textOutput != NULL && text == NULL ? textOutput :
+            binary == NULL ? binaryOutput : forward == NULL ? forwardOutput : positionalOutput;
+        printf("ERROR: Could not write index to file '%s'\n", failed);
+        exit(1);
+    }
+
+    // Ranges are in term order, so write them out one after another
+    for (int i = 0; i < numThreads && text != NULL; i++) {
+        fwrite(merges[i].text, 1, merges[i].textSize, text);
+    }
+
+    struct termRange *ranges = calloc(numThreads, sizeof(struct termRange));
+    for (int i = 0; i < numThreads; i++) {
+        ranges[i].numTerms = merges[i].numTerms;
+        ranges[i].names = merges[i].names;
+        ranges[i].terms = merges[i].terms;
+        ranges[i].postings = merges[i].postings;
+        ranges[i].postingsSize = merges[i].postingsSize;
+        ranges[i].bounds = merges[i].bounds;
+        ranges[i].boundsSize = merges[i].boundsSize;
+    }
+    writeBinaryIndex(binary, docs, ranges, numThreads);
+    free(ranges);
+
+    long numEntries;
+    struct forwardDoc *forwardDocs = calloc(docs->numDocs, sizeof(struct forwardDoc));
+    struct forwardEntry *entries = collectForwardEntries(docs, merges, numThreads,
+        forwardDocs, &numEntries);
+    writeForwardIndex(forward, docs, forwardDocs, entries, numEntries);
+    free(forwardDocs);
+    free(entries);
+    if (positional) writePositionalIndex(positions, docs, merges, numThreads);
+
+    if (text != NULL) fclose(text);
+    commitReplacement(binary, binaryOutput);
+    commitReplacement(forward, forwardOutput);
+    if (positional) commitReplacement(positions, positionalOutput);
+
+    for (int i = 0; i < numThreads; i++) {
+        free(merges[i].names);
+        free(merges[i].terms);
+        free(merges[i].text);
+        free(merges[i].postings);
+        free(merges[i].bounds);
+        free(merges[i].postingDocs);
+        free(merges[i].postingFreqs);
+        free(merges[i].positions);
+        free(merges[i].postingPositions);
+    }
+
+    free(merges);
+}
+
+// Reads the URLs of a collection and numbers them in order of first
+// appearance. URLs listed more than once keep their first ID
+docTable readDocTable(char *collection) {
+    collectionReader reader = openCollection(collection);
+
+    int size = 64;
+    int numUrls = 0;
+    char **urls = calloc(size, sizeof(char *));
+
+    char *url;
+    while ((url = nextCollectionUrl(reader)) != NULL) {
+        if (numUrls == size) {
+            size *= 2;
+            urls = realloc(urls, size * sizeof(char *));
+        }
+
+        urls[numUrls] = stringJoin(url, "");
+        numUrls++;
+    }
+
+    closeCollection(reader);
+
+    docTable docs = newDocTable(urls, numUrls);
+
+    for (int i = 0; i < numUrls; i++) free(urls[i]);
+    free(urls);
+    return docs;
+}
+
+// Numbers a list of URLs in order of first appearance. URLs listed more
+// than once keep their first ID
+docTable newDocTable(char **urls, int numUrls) {
+    struct urlEntry *entries = calloc(numUrls, sizeof(struct urlEntry));
+
+    for (int i = 0; i < numUrls; i++) {
+        entries[i].url = stringJoin(urls[i], "");
+        entries[i].collation = newCollationKey(urls[i]);
+        entries[i].index = i;
+    }
+
+    // Sort the URLs so that repeats sit next to their first appearance
+    qsort(entries, numUrls, sizeof(struct urlEntry), compareUrlEntries);
+
+    int *ids = calloc(numUrls, sizeof(int));
+    int *isRepeat = calloc(numUrls, sizeof(int));
+    for (int i = 1; i < numUrls; i++) {
+        if (strcmp(entries[i].url, entries[i - 1].url) == 0) {
+            isRepeat[entries[i].index] = 1;
+        }
+    }
+
+    // Number the first appearance of each URL in collection order
+    docTable docs = malloc(sizeof(struct _docTable));
+    docs->numDocs = 0;
+    for (int i = 0; i < numUrls; i++) {
+        if (!isRepeat[i]) {
+            ids[i] = docs->numDocs;
+            docs->numDocs++;
+        }
+    }
+
+    docs->urls = calloc(docs->numDocs, sizeof(char *));
+    docs->lengths = calloc(docs->numDocs, sizeof(int));
+    docs->rank = calloc(docs->numDocs, sizeof(int));
+    docs->byRank = calloc(docs->numDocs, sizeof(int));
+
+    int rank = 0;
+    for (int i = 0; i < numUrls; i++) {
+        if (isRepeat[entries[i].index]) {
+            free(entries[i].url);
+        } else {
+            int id = ids[entries[i].index];
+            docs->urls[id] = entries[i].url;
+            docs->rank[id] = rank;
+            docs->byRank[rank] = id;
+            rank++;
+        }
+        freeCollationKey(entries[i].collation);
+    }
+
+    free(entries);
+    free(ids);
+    free(isRepeat);
+    return docs;
+}
+
+// Frees the memory occupied by a document table
+void freeDocTable(docTable docs) {
+    for (int i = 0; i < docs->numDocs; i++) free(docs->urls[i]);
+    free(docs->urls);
+    free(docs->lengths);
+    free(docs->rank);
+    free(docs->byRank);
+    free(docs);
+}
+
+// Indexes the Section-2 words of documents start to end - 1, and returns
+// the words found as a sorted run. If positional is set, the position of
+// every word within its section is recorded too. If links is not NULL,
+// the Section-1 links of each document are put in it
+termRun indexDocRange(docTable docs, int start, int end, int positional, linkTable links) {
+    stringBST words = NULL;
+    int numTerms = 0;
+    pageReader pages = openPageReader(docs->urls + start, end - start, READ_URING | READ_STORED);
+
+    for (int id = start; id < end; id++) {
+        // Read all words from section into a string list
+        char *sectionText = nextPageSection(pages, "Section-2");
+        if (links != NULL) putLinks(links, id, getPageSection(pages, "Section-1"));
+        stringList urlWords = readWords(sectionText);
+        docs->lengths[id] = stringListLength(urlWords);
+        int position = 0;
+
+        for (stringNode currW = urlWords->start; currW != NULL; currW = currW->next) {
+            char *word = cleanString(currW->string);
+            stringBST node = getKeyBST(words, word);
+
+            // Insert word into BST
+            if (node == NULL) {
+                if (words == NULL) node = words = newStringBST(word);
+                else node = insertKeyBST(words, word);
+                numTerms++;
+            }
+
+            // Documents are indexed in order, so the document is only
+            // ever already in the vector as its last ID
+            idVector ids = node->ids;
+            if (ids->length == 0 || ids->ids[ids->length - 1] != id) {
+                appendIdVector(ids, id);
+                appendIdVector(node->freqs, 1);
+            } else {
+                node->freqs->ids[ids->length - 1]++;
+            }
+
+            if (positional) {
+                if (node->positions == NULL) node->positions = newIdVector();
+                appendIdVector(node->positions, position);
+            }
+
+            position++;
+            free(word);
+        }
+
+        free(sectionText);
+        freeStringList(urlWords);
+    }
+    closePageReader(pages);
+
+    termRun run = malloc(sizeof(struct _termRun));
+    run->tree = words;
+    run->numTerms = 0;
+    run->terms = calloc(numTerms, sizeof(stringBST));
+    collectBST(words, run->terms, &run->numTerms);
+
+    // The BST lets a word that is a prefix of another land on either side
+    // of it, so sort the terms strictly to allow runs to be merged
+    qsort(run->terms, run->numTerms, sizeof(stringBST), compareTermPointers);
+
+    return run;
+}
+
+// Frees the memory occupied by a term run. Every node of the tree is in the
+// terms array, so nodes are freed one at a time from there
+void freeTermRun(termRun run) {
+    for (int i = 0; i < run->numTerms; i++) {
+        run->terms[i]->left = NULL;
+        run->terms[i]->right = NULL;
+        freeStringBST(run->terms[i]);
+    }
+    free(run->terms);
+    free(run);
+}
+
+// Runs each task on its own thread and waits for them all to finish.
+// A task that cannot be given a thread runs on the calling thread instead
+static void runTasks(void *(*function)(void *), void *tasks, size_t taskSize, int numTasks) {
+    pthread_t *threads = calloc(numTasks, sizeof(pthread_t));
+    int *started = calloc(numTasks, sizeof(int));
+
+    for (int i = 0; i < numTasks; i++) {
+        void *task = (char *)tasks + i * taskSize;
+        started[i] = (pthread_create(&threads[i], NULL, function, task) == 0);
+        if (!started[i]) function(task);
+    }
+
+    for (int i = 0; i < numTasks; i++) {
+        if (started[i]) pthread_join(threads[i], NULL);
+    }
+
+    free(threads);
+    free(started);
+}
+
+static void *mapDocs(void *arg) {
+    struct mapTask *task = arg;
+    task->run = indexDocRange(task->docs, task->start, task->end, task->positional,
+        task->links);
+    return NULL;
+}
+
+// Orders terms by collation key, then by their exact string
+static int compareTerms(stringBST term1, stringBST term2) {
+    int cmp = collationCompare(term1->collation, term2->collation);
+    if (cmp != 0) return cmp;
+    return strcmp(term1->key, term2->key);
+}
+
+static int compareTermPointers(const void *a, const void *b) {
+    return compareTerms(*(stringBST *)a, *(stringBST *)b);
+}
+
+// Orders URLs by collation key, then exact string, then collection position
+static int compareUrlEntries(const void *a, const void *b) {
+    const struct urlEntry *entry1 = a;
+    const struct urlEntry *entry2 = b;
+
+    int cmp = collationCompare(entry1->collation, entry2->collation);
+    if (cmp == 0) cmp = strcmp(entry1->url, entry2->url);
+    if (cmp == 0) cmp = entry1->index - entry2->index;
+    return cmp;
+}
+
+static int compareInts(const void *a, const void *b) {
+    return *(int *)a - *(int *)b;
+}
+
+static void *mergeRuns(void *arg) {
+    struct mergeTask *task = arg;
+    FILE *text = open_memstream(&task->text, &task->textSize);
+    FILE *postings = open_memstream(&task->postings, &task->postingsSize);
+    FILE *bounds = open_memstream(&task->bounds, &task->boundsSize);
+    FILE *positions = NULL;
+    if (task->positional) positions = open_memstream(&task->positions, &task->positionsSize);
+
+    int *pos = calloc(task->numRuns, sizeof(int));
+    int *end = calloc(task->numRuns, sizeof(int));
+    int *ids = calloc(task->docs->numDocs, sizeof(int));
+    unsigned char *encoded = malloc(skipPostingsBound(task->docs->numDocs));
+
+    int size = 64;
+    task->numTerms = 0;
+    task->names = calloc(size, sizeof(char *));
+    task->terms = calloc(size, sizeof(struct indexTerm));
+
+    long postingsCapacity = 64;
+    task->numPostings = 0;
+    task->postingDocs = calloc(postingsCapacity, sizeof(int));
+    task->postingFreqs = calloc(postingsCapacity, sizeof(int));
+    task->postingPositions = NULL;
+    if (task->positional) task->postingPositions = calloc(postingsCapacity, sizeof(unsigned int));
+
+    // Find where the range starts and ends in each run
+    for (int r = 0; r < task->numRuns; r++) {
+        termRun run = task->runs[r];
+        pos[r] = task->low == NULL ? 0 : lowerBound(run, task->low);
+        end[r] = task->high == NULL ? run->numTerms : lowerBound(run, task->high);
+    }
+
+    while (1) {
+        // Find the smallest term not yet written
+        stringBST min = NULL;
+        for (int r = 0; r < task->numRuns; r++) {
+            if (pos[r] == end[r]) continue;
+            stringBST term = task->runs[r]->terms[pos[r]];
+            if (min == NULL || compareTerms(term, min) < 0) min = term;
+        }
+
+        if (min == NULL) break;
+
+        // Runs cover ascending ranges of documents, so joining the term's
+        // IDs from each run in turn keeps them sorted
+        int length = 0;
+        for (int r = 0; r < task->numRuns; r++) {
+            if (pos[r] == end[r]) continue;
+            stringBST term = task->runs[r]->terms[pos[r]];
+            if (compareTerms(term, min) == 0) {
+                int numIds = term->ids->length;
+
+                while (task->numPostings + numIds > postingsCapacity) {
+                    postingsCapacity *= 2;
+                    task->postingDocs = realloc(task->postingDocs, postingsCapacity * sizeof(int));
+                    task->postingFreqs = realloc(task->postingFreqs, postingsCapacity * sizeof(int));
+                    if (task->positional) {
+                        task->postingPositions = realloc(task->postingPositions,
+                            postingsCapacity * sizeof(unsigned int));
+                    }
+                }
+
+                // Each document's positions follow those of the one before
+                if (task->positional) {
+                    int *termPositions = term->positions->ids;
+                    for (int k = 0; k < numIds; k++) {
+                        task->postingPositions[task->numPostings + k] = ftell(positions);
+                        writePositions(positions, termPositions, term->freqs->ids[k]);
+                        termPositions += term->freqs->ids[k];
+                    }
+                }
+
+                memcpy(ids + length, term->ids->ids, numIds * sizeof(int));
+                memcpy(task->postingDocs + task->numPostings, term->ids->ids, numIds * sizeof(int));
+                memcpy(task->postingFreqs + task->numPostings, term->freqs->ids, numIds * sizeof(int));
+                task->numPostings += numIds;
+                length += numIds;
+                pos[r]++;
+            }
+        }
+
+        if (task->numTerms == size) {
+            size *= 2;
+            task->names = realloc(task->names, size * sizeof(char *));
+            task->terms = realloc(task->terms, size * sizeof(struct indexTerm));
+        }
+
+        // Record the term and write its postings
+        struct indexTerm *t = &task->terms[task->numTerms];
+        task->names[task->numTerms] = min->key;
+        t->docFreq = length;
+        t->postings = ftell(postings);
+        t->postingsSize = encodeSkipPostings(ids, length, encoded);
+        fwrite(encoded, 1, t->postingsSize, postings);
+        t->bounds = ftell(bounds) / sizeof(float);
+        t->maxTf = writeTermBounds(bounds, ids, task->postingFreqs + task->numPostings - length,
+            task->docs->lengths, length);
+        task->numTerms++;
+
+        writeTermText(text, task->docs, min->key, ids, length);
+    }
+
+    fclose(text);
+    fclose(postings);
+    fclose(bounds);
+    if (positions != NULL) fclose(positions);
+    free(pos);
+    free(end);
+    free(ids);
+    free(encoded);
+    return NULL;
+}
+
+// Returns the position of the first term in a run that is not before the given term
+static int lowerBound(termRun run, stringBST term) {
+    int low = 0;
+    int high = run->numTerms;
+
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (compareTerms(run->terms[mid], term) < 0) low = mid + 1;
+        else high = mid;
+    }
+
+    return low;
+}
+
+// Writes a term and its URLs as one line of the text index, with the URLs
+// sorted by name. Sorts the IDs in place
+void writeTermText(FILE *file, docTable docs, char *term, int *ids, int length) {
+    for (int i = 0; i < length; i++) ids[i] = docs->rank[ids[i]];
+    qsort(ids, length, sizeof(int), compareInts);
+
+    fprintf(file, "%s ", term);
+
+    for (int i = 0; i < length; i++) {
+        fprintf(file, " %s", docs->urls[docs->byRank[ids[i]]]);
+    }
+
+    fprintf(file, "\n");
+}
+
+// Writes the binary index file from ranges of merged terms, given in term
+// order. Both the parallel and the single-pass builds write through here
+void writeBinaryIndex(FILE *file, docTable docs, struct termRange *ranges, int numRanges) {
+    int numTerms = 0;
+    size_t boundsSize = 0;
+    for (int i = 0; i < numRanges; i++) {
+        numTerms += ranges[i].numTerms;
+        boundsSize += ranges[i].boundsSize;
+    }
+
+    // Keep the hash table at most half full
+    unsigned int docHashSize = 1;
+    while (docHashSize < 2 * (unsigned int)docs->numDocs) docHashSize *= 2;
+
+    struct indexDoc *docEntries = calloc(docs->numDocs, sizeof(struct indexDoc));
+    struct indexTerm *terms = calloc(numTerms, sizeof(struct indexTerm));
+    char **names = calloc(numTerms, sizeof(char *));
+    unsigned int *docHash = calloc(docHashSize, sizeof(unsigned int));
+
+    // Lay out the URLs, then the terms, in the strings region
+    unsigned int stringsSize = 0;
+    for (int i = 0; i < docs->numDocs; i++) {
+        docEntries[i].url = stringsSize;
+        docEntries[i].rank = docs->rank[i];
+        stringsSize += strlen(docs->urls[i]) + 1;
+
+        unsigned int slot = hashTerm(docs->urls[i]) & (docHashSize - 1);
+        while (docHash[slot] != 0) slot = (slot + 1) & (docHashSize - 1);
+        docHash[slot] = i + 1;
+    }
+
+    int t = 0;
+    unsigned int postingsBase = 0;
+    unsigned int boundsBase = 0;
+    for (int i = 0; i < numRanges; i++) {
+        for (int j = 0; j < ranges[i].numTerms; j++) {
+            terms[t] = ranges[i].terms[j];
+            terms[t].name = stringsSize;
+            terms[t].postings += postingsBase;
+            terms[t].bounds += boundsBase;
+            names[t] = ranges[i].names[j];
+            stringsSize += strlen(names[t]) + 1;
+            t++;
+        }
+        postingsBase += ranges[i].postingsSize;
+        boundsBase += ranges[i].boundsSize / sizeof(float);
+    }
+
+    unsigned int fstSize;
+    struct indexHeader header;
+    unsigned char *fst = buildFst(names, numTerms, &fstSize, &header.fstRoot);
+    unsigned char *bloom = buildBloomFilter(names, numTerms, &header.bloomBlocks);
+
+    header.magic = INDEX_MAGIC;
+    header.version = INDEX_VERSION;
+    header.numDocs = docs->numDocs;
+    header.numTerms = numTerms;
+    header.docHashSize = docHashSize;
+    header.bloomOffset = alignBloomOffset(sizeof(struct indexHeader));
+    header.docsOffset = header.bloomOffset + header.bloomBlocks * BLOOM_BLOCK_SIZE;
+    header.termsOffset = header.docsOffset + docs->numDocs * sizeof(struct indexDoc);
+    header.docHashOffset = header.termsOffset + numTerms * sizeof(struct indexTerm);
+    header.boundsOffset = header.docHashOffset + docHashSize * sizeof(unsigned int);
+    header.fstOffset = header.boundsOffset + boundsSize;
+    header.stringsOffset = header.fstOffset + fstSize;
+    header.postingsOffset = header.stringsOffset + stringsSize;
+
+    fwrite(&header, sizeof(struct indexHeader), 1, file);
+    for (size_t i = sizeof(struct indexHeader); i < header.bloomOffset; i++) fputc(0, file);
+    fwrite(bloom, BLOOM_BLOCK_SIZE, header.bloomBlocks, file);
+    fwrite(docEntries, sizeof(struct indexDoc), docs->numDocs, file);
+    fwrite(terms, sizeof(struct indexTerm), numTerms, file);
+    fwrite(docHash, sizeof(unsigned int), docHashSize, file);
+    for (int i = 0; i < numRanges; i++) fwrite(ranges[i].bounds, 1, ranges[i].boundsSize, file);
+    fwrite(fst, 1, fstSize, file);
+
+    for (int i = 0; i < docs->numDocs; i++) fwrite(docs->urls[i], 1, strlen(docs->urls[i]) + 1, file);
+    for (int i = 0; i < numTerms; i++) fwrite(names[i], 1, strlen(names[i]) + 1, file);
+    for (int i = 0; i < numRanges; i++) fwrite(ranges[i].postings, 1, ranges[i].postingsSize, file);
+
+    free(docEntries);
+    free(terms);
+    free(names);
+    free(docHash);
+    free(fst);
+    free(bloom);
+}
+
+// Writes the forward index file from each document's entries, which must
+// be sorted by term number. Document lengths are taken from the table
+void writeForwardIndex(FILE *file, docTable docs, struct forwardDoc *docEntries,
+    struct forwardEntry *entries, long numEntries) {
+    for (int d = 0; d < docs->numDocs; d++) docEntries[d].length = docs->lengths[d];
+
+    struct forwardHeader header;
+    header.magic = FORWARD_MAGIC;
+    header.version = FORWARD_VERSION;
+    header.numDocs = docs->numDocs;
+    header.numEntries = numEntries;
+    header.docsOffset = sizeof(struct forwardHeader);
+    header.entriesOffset = header.docsOffset + docs->numDocs * sizeof(struct forwardDoc);
+
+    fwrite(&header, sizeof(struct forwardHeader), 1, file);
+    fwrite(docEntries, sizeof(struct forwardDoc), docs->numDocs, file);
+    fwrite(entries, sizeof(struct forwardEntry), numEntries, file);
+}
+
+// Gives each document its slice of forward index entries from the merged
+// postings, and returns the entries. Terms are visited in ascending order,
+// so each document's entries come out sorted by term number
+static struct forwardEntry *collectForwardEntries(docTable docs, struct mergeTask *merges,
+    int numMerges, struct forwardDoc *docEntries, long *numEntries) {
+    *numEntries = 0;
+
+    // Count the terms in each document, then give each document its slice
+    for (int i = 0; i < numMerges; i++) {
+        for (long p = 0; p < merges[i].numPostings; p++) {
+            docEntries[merges[i].postingDocs[p]].numTerms++;
+        }
+    }
+
+    for (int d = 0; d < docs->numDocs; d++) {
+        docEntries[d].entries = *numEntries;
+        *numEntries += docEntries[d].numTerms;
+    }
+
+    struct forwardEntry *entries = calloc(*numEntries, sizeof(struct forwardEntry));
+    int *filled = calloc(docs->numDocs, sizeof(int));
+
+    int t = 0;
+    for (int i = 0; i < numMerges; i++) {
+        long p = 0;
+        for (int j = 0; j < merges[i].numTerms; j++) {
+            for (unsigned int k = 0; k < merges[i].terms[j].docFreq; k++) {
+                int doc = merges[i].postingDocs[p];
+                struct forwardEntry *entry = &entries[docEntries[doc].entries + filled[doc]];
+                entry->term = t;
+                entry->count = merges[i].postingFreqs[p];
+                filled[doc]++;
+                p++;
+            }
+            t++;
+        }
+    }
+
+    free(filled);
+    return entries;
+}
+
+// Writes the ascending word positions of one document as a varint count
+// followed by varint gaps
+static void writePositions(FILE *file, int *positions, int count) {
+    unsigned char encoded[MAX_VARINT];
+    int prev = 0;
+
+    fwrite(encoded, 1, encodeVarint(count, encoded), file);
+
+    for (int i = 0; i < count; i++) {
+        fwrite(encoded, 1, encodeVarint(positions[i] - prev, encoded), file);
+        prev = positions[i];
+    }
+}
+
+// Writes the positional index file. Postings are kept in term order, so
+// each term's document entries are the next docFreq postings
+static void writePositionalIndex(FILE *file, docTable docs, struct mergeTask *merges, int numMerges) {
+    int numTerms = 0;
+    long numPostings = 0;
+    for (int i = 0; i < numMerges; i++) {
+        numTerms += merges[i].numTerms;
+        numPostings += merges[i].numPostings;
+    }
+
+    struct positionalHeader header;
+    header.magic = POSITIONAL_MAGIC;
+    header.version = POSITIONAL_VERSION;
+    header.numTerms = numTerms;
+    header.numDocs = numPostings;
+    header.indexDocs = docs->numDocs;
+    header.termsOffset = sizeof(struct positionalHeader);
+    header.docsOffset = header.termsOffset + numTerms * sizeof(struct positionalTerm);
+    header.positionsOffset = header.docsOffset + numPostings * sizeof(struct positionalDoc);
+
+    struct positionalTerm *terms = calloc(numTerms, sizeof(struct positionalTerm));
+    struct positionalDoc *docEntries = calloc(numPostings, sizeof(struct positionalDoc));
+
+    int t = 0;
+    long p = 0;
+    unsigned int positionsBase = 0;
+    for (int i = 0; i < numMerges; i++) {
+        for (int j = 0; j < merges[i].numTerms; j++) {
+            terms[t].docs = p;
+            terms[t].docFreq = merges[i].terms[j].docFreq;
+            t++;
+            p += merges[i].terms[j].docFreq;
+        }
+
+        long first = p - merges[i].numPostings;
+        for (long k = 0; k < merges[i].numPostings; k++) {
+            docEntries[first + k].doc = merges[i].postingDocs[k];
+            docEntries[first + k].positions = positionsBase + merges[i].postingPositions[k];
+        }
+        positionsBase += merges[i].positionsSize;
+    }
+
+    fwrite(&header, sizeof(struct positionalHeader), 1, file);
+    fwrite(terms, sizeof(struct positionalTerm), numTerms, file);
+    fwrite(docEntries, sizeof(struct positionalDoc), numPostings, file);
+    for (int i = 0; i < numMerges; i++) fwrite(merges[i].positions, 1, merges[i].positionsSize, file);
+
+    free(terms);
+    free(docEntries);
+}
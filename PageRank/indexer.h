@@ -0,0 +1,64 @@
+#ifndef INDEXER_H
+#define INDEXER_H
+
+#include "text.h"
+#include "index.h"
+#include "pipeline.h"
+
+typedef struct _docTable *docTable;
+typedef struct _termRun *termRun;
+
+// The documents of a collection, with IDs given in collection order
+struct _docTable {
+    int numDocs;
+    char **urls;
+    int *lengths;   // Number of Section-2 words in each document
+    int *rank;      // Position of each document when sorted by URL
+    int *byRank;    // Document IDs sorted by URL
+};
+
+// Terms found in one range of documents, sorted by collation key. Each
+// term's ID vector holds the documents containing it, in ID order, and its
+// frequency vector holds how many times it appears in each. If positions
+// were recorded, each term's position vector holds the word positions of
+// each of its documents in turn
+struct _termRun {
+    stringBST tree;
+    int numTerms;
+    stringBST *terms;
+};
+
+// A range of merged terms in term order, ready to be written to the binary
+// index. The postings and bounds offsets of its terms are from the start
+// of its own postings and bounds
+struct termRange {
+    int numTerms;
+    char **names;
+    struct indexTerm *terms;
+    char *postings;
+    size_t postingsSize;
+    char *bounds;
+    size_t boundsSize;
+};
+
+int defaultThreads();
+void buildInvertedIndex(char *collection, char *textOutput, char *binaryOutput,
+    char *forwardOutput, char *positionalOutput, int numThreads);
+void buildIndex(docTable docs, char *textOutput, char *binaryOutput,
+    char *forwardOutput, char *positionalOutput, int numThreads, linkTable links);
+void writeRuns(docTable docs, termRun *runs, int numRuns, char *textOutput,
+    char *binaryOutput, char *forwardOutput, char *positionalOutput, int numThreads);
+
+docTable readDocTable(char *collection);
+docTable newDocTable(char **urls, int numUrls);
+void freeDocTable(docTable docs);
+
+termRun indexDocRange(docTable docs, int start, int end, int positional, linkTable links);
+void freeTermRun(termRun run);
+
+void writeTermText(FILE *file, docTable docs, char *term, int *ids, int length);
+void writeBinaryIndex(FILE *file, docTable docs, struct termRange *ranges, int numRanges);
+void writeForwardIndex(FILE *file, docTable docs, struct forwardDoc *docEntries,
+    struct forwardEntry *entries, long numEntries);
+
+#endif
@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "indexer.h"
+#include "impact.h"
+#include "segments.h"
+#include "pipeline.h"
+#include "weightedRank.h"
+
+void printUsage();
+
+int main(int argc, char *argv[]) {
+    int numThreads = defaultThreads();
+    char *positionalOutput = NULL;
+    int impact = 0;
+    int arg = 1;
+
+    while (arg < argc && argv[arg][0] == '-') {
+        if (strcmp(argv[arg], "-p") == 0) {
+            // -p also writes the word positions needed for phrase queries
+            positionalOutput = "positionalIndex.bin";
+            arg++;
+        } else if (strcmp(argv[arg], "-i") == 0) {
+            // -i also writes the impact-ordered index used by searchTfIdf -impact
+            impact = 1;
+            arg++;
+        } else {
+            printf("ERROR: Unknown option '%s'\n", argv[arg]);
+            printUsage();
+        }
+    }
+
+    if (argc - arg < 3) {
+        printf("ERROR: Not enough arguments\n");
+        printUsage();
+    }
+
+    double damping = atof(argv[arg]);
+    double diffPR = atof(argv[arg + 1]);
+    int maxIterations = atoi(argv[arg + 2]);
+    arg += 3;
+
+    if (arg < argc) {
+        numThreads = atoi(argv[arg]);
+
+        if (numThreads < 1) {
+            printf("ERROR: Invalid number of threads '%s'\n", argv[arg]);
+            printUsage();
+        }
+    }
+
+    // Read each page once for both the index and the link graph
+    graph g = ingestCollection("collection.txt", "invertedIndex.txt", "invertedIndex.bin",
+        "forwardIndex.bin", positionalOutput, numThreads);
+
+    // Positional and impact indexes left from an earlier build no longer
+    // match, so they are removed unless they were rebuilt too
+    if (positionalOutput == NULL) unlink(BASE_POSITIONAL);
+    if (impact) buildImpactIndex("invertedIndex.bin", "forwardIndex.bin", BASE_IMPACT);
+    else unlink(BASE_IMPACT);
+
+    // The rebuilt index already holds every page, so drop the segments
+    // added since the last build
+    clearSegments();
+
+    // Rank once the index exists, so the pageranks are also stored by the
+    // index's document IDs
+    pageRankW(g, damping, diffPR, maxIterations);
+    freeGraph(g);
+
+    return 0;
+}
+
+// Prints how to run the program, and exits
+void printUsage() {
+    printf("ingest [-p] [-i] <damping> <diffPR> <maxIterations> [numThreads]\n");
+    exit(1);
+}
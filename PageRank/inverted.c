@@ -1,72 +1,77 @@
 #include <stdio.h>
-#include <string.h>
 #include <stdlib.h>
-
-#include "text.h"
-
-void writeWordsBST(stringBST words, FILE* file);
-
-int main(void) {
-    stringList urls = readCollection("collection.txt");
-    stringBST words = NULL;
-
-    // Iterate through each URL in collection
-    for (stringNode curr = urls->start; curr != NULL; curr = curr->next) {
-        char *url = curr->string;
-        char *filename = stringJoin(url, ".txt");
-
-        // Read all words from section into a string list
-        char *sectionText = readSection(filename, "Section-2");
-        stringList urlWords = readWords(sectionText);
-
-        // Iterate through each word
-        for (stringNode currW = urlWords->start; currW != NULL; currW = currW->next) {
-            char *word = cleanString(currW->string);
-            
-            if (words == NULL) words = newStringBST(word);
-
-            // Insert word into BST
-            if (getKeyBST(words, word) == NULL) {
-                insertKeyBST(words, word);
+#include <string.h>
+#include <unistd.h>
+
+#include "indexer.h"
+#include "impact.h"
+#include "segments.h"
+#include "spimi.h"
+
+void printUsage();
+
+int main(int argc, char *argv[]) {
+    int numThreads = defaultThreads();
+    char *positionalOutput = NULL;
+    int impact = 0;
+    long memoryBudget = 0;
+    int arg = 1;
+
+    while (arg < argc && argv[arg][0] == '-') {
+        if (strcmp(argv[arg], "-p") == 0) {
+            // -p also writes the word positions needed for phrase queries
+            positionalOutput = "positionalIndex.bin";
+            arg++;
+        } else if (strcmp(argv[arg], "-i") == 0) {
+            // -i also writes the impact-ordered index used by searchTfIdf -impact
+            impact = 1;
+            arg++;
+        } else if (strcmp(argv[arg], "-m") == 0 && arg + 1 < argc) {
+            // -m builds in a single pass within a memory budget in megabytes
+            memoryBudget = atof(argv[arg + 1]) * MEGABYTE;
+            if (memoryBudget < 1) {
+                printf("ERROR: Invalid memory budget '%s'\n", argv[arg + 1]);
+                printUsage();
             }
+            arg += 2;
+        } else {
+            printf("ERROR: Unknown option '%s'\n", argv[arg]);
+            printUsage();
+        }
+    }
 
-            // Add URL to list of URLs containing word
-            stringBST currNode = getKeyBST(words, word);
-
-            if (!inStringList(currNode->list, url)) {
-                insertSorted(currNode->list, url);
-            }
+    if (arg < argc) {
+        numThreads = atoi(argv[arg]);
 
-            free(word);
+        if (numThreads < 1) {
+            printf("ERROR: Invalid number of threads '%s'\n", argv[arg]);
+            printUsage();
         }
-
-        free(filename);
-        free(sectionText);
-        freeStringList(urlWords);
     }
 
-    FILE* output = fopen("invertedIndex.txt", "w");
+    if (memoryBudget > 0) {
+        buildSpimiIndex("collection.txt", "invertedIndex.txt", "invertedIndex.bin",
+            "forwardIndex.bin", positionalOutput, memoryBudget);
+    } else {
+        buildInvertedIndex("collection.txt", "invertedIndex.txt", "invertedIndex.bin",
+            "forwardIndex.bin", positionalOutput, numThreads);
+    }
 
-    writeWordsBST(words, output);
+    // Positional and impact indexes left from an earlier build no longer
+    // match, so they are removed unless they were rebuilt too
+    if (positionalOutput == NULL) unlink(BASE_POSITIONAL);
+    if (impact) buildImpactIndex("invertedIndex.bin", "forwardIndex.bin", BASE_IMPACT);
+    else unlink(BASE_IMPACT);
 
-    freeStringList(urls);
-    freeStringBST(words);
+    // The rebuilt index already holds every page, so drop the segments
+    // added since the last build
+    clearSegments();
 
     return 0;
 }
 
-// Traverse tree in-order and write each word and URLs to file
-void writeWordsBST(stringBST words, FILE* file) {
-    if (words == NULL) return;
-    writeWordsBST(words->left, file);
-
-    fprintf(file, "%s ", words->key);
-
-    for (stringNode currU = words->list->start; currU != NULL; currU = currU->next) {
-        fprintf(file, " %s", currU->string);
-    }
-
-    fprintf(file, "\n");
-
-    writeWordsBST(words->right, file);
+// Prints how to run the program, and exits
+void printUsage() {
+    printf("inverted [-p] [-i] [-m megabytes] [numThreads]\n");
+    exit(1);
 }
@@ -0,0 +1,390 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "loader.h"
+#include "text.h"
+
+// States of a slot in the read window
+#define SLOT_EMPTY 0
+#define SLOT_READING 1
+#define SLOT_READY 2
+#define SLOT_FAILED 3
+
+static int openQueues(struct uringQueues *q, unsigned entries);
+static void closeQueues(struct uringQueues *q);
+static void startUringReads(pageReader reader);
+static void queueRead(struct uringQueues *q, struct pageSlot *slot, int page);
+static void submitReads(struct uringQueues *q, int wait);
+static void finishUringReads(pageReader reader);
+static int openPageFile(pageReader reader, struct pageSlot *slot, char *url);
+static void *readPages(void *arg);
+static int readWholePage(pageReader reader, struct pageSlot *slot, char *url);
+
+// Starts reading the pages of a list of URLs. Reads go through io_uring if
+// READ_URING is set and the kernel allows it, and through threads
+// otherwise. If READ_STORED is set, pages in the page store are not read
+// unless their files have changed since they were packed
+pageReader openPageReader(char **urls, int numUrls, int flags) {
+    pageReader reader = malloc(sizeof(struct _pageReader));
+    reader->urls = urls;
+    reader->numUrls = numUrls;
+    reader->numStarted = 0;
+    reader->numReturned = 0;
+    reader->current = NULL;
+    reader->currentStored = NOT_STORED;
+    reader->store = flags & READ_STORED ? openPageStore(PAGE_STORE) : NULL;
+    reader->numThreads = 0;
+    reader->stopping = 0;
+    memset(reader->slots, 0, sizeof(reader->slots));
+    for (int i = 0; i < READ_WINDOW; i++) reader->slots[i].stored = NOT_STORED;
+    pthread_mutex_init(&reader->lock, NULL);
+    pthread_cond_init(&reader->changed, NULL);
+
+    reader->uring = (flags & READ_URING) && numUrls > 0 && openQueues(&reader->queues, READ_WINDOW);
+    if (reader->uring) {
+        startUringReads(reader);
+        return reader;
+    }
+
+    int numThreads = numUrls < READER_THREADS ? numUrls : READER_THREADS;
+    for (int i = 0; i < numThreads; i++) {
+        if (pthread_create(&reader->threads[reader->numThreads], NULL, readPages, reader) == 0) {
+            reader->numThreads++;
+        }
+    }
+
+    if (numThreads > 0 && reader->numThreads == 0) {
+        printf("ERROR: Could not start threads to read pages\n");
+        exit(1);
+    }
+    return reader;
+}
+
+// Returns the contents of the next page, or NULL if it could not be read.
+// The contents are freed by the following call
+char *nextPage(pageReader reader) {
+    free(reader->current);
+    reader->current = NULL;
+    reader->currentStored = NOT_STORED;
+    char *contents = NULL;
+
+    int page = reader->numReturned;
+    struct pageSlot *slot = &reader->slots[page % READ_WINDOW];
+
+    if (reader->uring) {
+        while (slot->state == SLOT_READING) finishUringReads(reader);
+    } else {
+        pthread_mutex_lock(&reader->lock);
+        while (slot->state == SLOT_EMPTY || slot->state == SLOT_READING) {
+            pthread_cond_wait(&reader->changed, &reader->lock);
+        }
+    }
+
+    // Free the slot for the page a window ahead
+    if (slot->state == SLOT_READY && slot->stored != NOT_STORED) {
+        reader->currentStored = slot->stored;
+        contents = slot->contents;
+    } else if (slot->state == SLOT_READY) {
+        slot->contents[slot->done] = '\0';
+        reader->current = contents = slot->contents;
+    }
+    slot->state = SLOT_EMPTY;
+    slot->contents = NULL;
+    reader->numReturned++;
+
+    if (reader->uring) {
+        startUringReads(reader);
+    } else {
+        pthread_cond_broadcast(&reader->changed);
+        pthread_mutex_unlock(&reader->lock);
+    }
+
+    return contents;
+}
+
+// Returns a copy of a section of the next page, as readSection does
+char *nextPageSection(pageReader reader, char *section) {
+    char *url = reader->urls[reader->numReturned];
+    char *contents = nextPage(reader);
+
+    if (contents == NULL) {
+        printf("ERROR: Could not read section '%s' from file '%s.txt'\n", section, url);
+        exit(1);
+    }
+
+    return getPageSection(reader, section);
+}
+
+// Returns a copy of a section of the page last returned, which must have
+// been read
+char *getPageSection(pageReader reader, char *section) {
+    if (reader->currentStored == NOT_STORED) return findSection(reader->current, section);
+
+    // Stored pages have their sections found already
+    int id = reader->currentStored;
+    int length;
+    char *start = getStoredSection(reader->store, id, section, &length);
+    if (start == NULL) return findSection(getStoredContents(reader->store, id), section);
+
+    char *sectionText = malloc(length + 1);
+    memcpy(sectionText, start, length);
+    sectionText[length] = '\0';
+    return sectionText;
+}
+
+// Stops reading pages, waiting for reads under way, and frees the reader
+void closePageReader(pageReader reader) {
+    if (reader->uring) {
+        for (int i = 0; i < READ_WINDOW; i++) {
+            while (reader->slots[i].state == SLOT_READING) finishUringReads(reader);
+        }
+        closeQueues(&reader->queues);
+    } else {
+        pthread_mutex_lock(&reader->lock);
+        reader->stopping = 1;
+        pthread_cond_broadcast(&reader->changed);
+        pthread_mutex_unlock(&reader->lock);
+        for (int i = 0; i < reader->numThreads; i++) pthread_join(reader->threads[i], NULL);
+    }
+
+    for (int i = 0; i < READ_WINDOW; i++) {
+        if (reader->slots[i].stored == NOT_STORED) free(reader->slots[i].contents);
+    }
+    free(reader->current);
+    closePageStore(reader->store);
+    pthread_mutex_destroy(&reader->lock);
+    pthread_cond_destroy(&reader->changed);
+    free(reader);
+}
+
+// Sets up an io_uring instance with room for entries reads at once, and
+// maps its queues. Returns 0 if the kernel does not allow it
+static int openQueues(struct uringQueues *q, unsigned entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    q->fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (q->fd < 0) return 0;
+
+    q->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    q->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    q->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    // Newer kernels map both rings at once
+    int single = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single && q->cqRingSize > q->sqRingSize) q->sqRingSize = q->cqRingSize;
+
+    q->sqRing = mmap(NULL, q->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+        q->fd, IORING_OFF_SQ_RING);
+    q->cqRing = single ? q->sqRing : mmap(NULL, q->cqRingSize, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, q->fd, IORING_OFF_CQ_RING);
+    q->sqes = mmap(NULL, q->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+        q->fd, IORING_OFF_SQES);
+
+    if (q->sqRing == MAP_FAILED || q->cqRing == MAP_FAILED || q->sqes == MAP_FAILED) {
+        if (q->sqes != MAP_FAILED) munmap(q->sqes, q->sqesSize);
+        if (!single && q->cqRing != MAP_FAILED) munmap(q->cqRing, q->cqRingSize);
+        if (q->sqRing != MAP_FAILED) munmap(q->sqRing, q->sqRingSize);
+        close(q->fd);
+        return 0;
+    }
+    if (single) q->cqRingSize = 0;
+
+    q->sqTail = (unsigned *)((char *)q->sqRing + params.sq_off.tail);
+    q->sqMask = (unsigned *)((char *)q->sqRing + params.sq_off.ring_mask);
+    q->sqArray = (unsigned *)((char *)q->sqRing + params.sq_off.array);
+    q->cqHead = (unsigned *)((char *)q->cqRing + params.cq_off.head);
+    q->cqTail = (unsigned *)((char *)q->cqRing + params.cq_off.tail);
+    q->cqMask = (unsigned *)((char *)q->cqRing + params.cq_off.ring_mask);
+    q->cqes = (struct io_uring_cqe *)((char *)q->cqRing + params.cq_off.cqes);
+    q->numQueued = 0;
+    return 1;
+}
+
+// Unmaps an io_uring instance's queues and closes it
+static void closeQueues(struct uringQueues *q) {
+    munmap(q->sqes, q->sqesSize);
+    if (q->cqRingSize > 0) munmap(q->cqRing, q->cqRingSize);
+    munmap(q->sqRing, q->sqRingSize);
+    close(q->fd);
+}
+
+// Starts reading every page that fits in the window, and submits the reads
+// together
+static void startUringReads(pageReader reader) {
+    while (reader->numStarted < reader->numUrls &&
+        reader->numStarted < reader->numReturned + READ_WINDOW) {
+        int page = reader->numStarted;
+        struct pageSlot *slot = &reader->slots[page % READ_WINDOW];
+
+        slot->state = openPageFile(reader, slot, reader->urls[page]);
+        if (slot->state == SLOT_READING) queueRead(&reader->queues, slot, page);
+        reader->numStarted++;
+    }
+
+    submitReads(&reader->queues, 0);
+}
+
+// Adds a read of the rest of a page to the submission queue
+static void queueRead(struct uringQueues *q, struct pageSlot *slot, int page) {
+    unsigned tail = *q->sqTail;
+    unsigned index = tail & *q->sqMask;
+    struct io_uring_sqe *sqe = &q->sqes[index];
+
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = slot->fd;
+    sqe->addr = (unsigned long)(slot->contents + slot->done);
+    sqe->len = slot->size - slot->done;
+    sqe->off = slot->done;
+    sqe->user_data = page;
+
+    q->sqArray[index] = index;
+    __atomic_store_n(q->sqTail, tail + 1, __ATOMIC_RELEASE);
+    q->numQueued++;
+}
+
+// Submits the queued reads, and if wait is set, waits for one to finish
+static void submitReads(struct uringQueues *q, int wait) {
+    if (q->numQueued == 0 && !wait) return;
+
+    int submitted = syscall(__NR_io_uring_enter, q->fd, q->numQueued, wait ? 1 : 0,
+        wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    if (submitted < 0) {
+        printf("ERROR: Could not submit page reads\n");
+        exit(1);
+    }
+    q->numQueued -= submitted;
+}
+
+// Waits for at least one read to finish, then handles every finished read.
+// A page read only in part has the rest of its read queued again
+static void finishUringReads(pageReader reader) {
+    struct uringQueues *q = &reader->queues;
+    submitReads(q, 1);
+
+    unsigned head = *q->cqHead;
+    unsigned tail = __atomic_load_n(q->cqTail, __ATOMIC_ACQUIRE);
+
+    while (head != tail) {
+        struct io_uring_cqe *cqe = &q->cqes[head & *q->cqMask];
+        int page = cqe->user_data;
+        struct pageSlot *slot = &reader->slots[page % READ_WINDOW];
+
+        if (cqe->res < 0) {
+            slot->state = SLOT_FAILED;
+        } else {
+            slot->done += cqe->res;
+
+            // A page that has shrunk since it was opened ends early
+            if (cqe->res > 0 && slot->done < slot->size) queueRead(q, slot, page);
+            else slot->state = SLOT_READY;
+        }
+
+        if (slot->state != SLOT_READING) close(slot->fd);
+        head++;
+    }
+
+    __atomic_store_n(q->cqHead, head, __ATOMIC_RELEASE);
+    submitReads(q, 0);
+}
+
+// Opens a page's file and allocates room for its contents. Returns the
+// state the slot is then in, SLOT_READING if there is anything to read,
+// leaving the caller to set it. A page in the page store is ready at once,
+// unless its file has changed since it was packed
+static int openPageFile(pageReader reader, struct pageSlot *slot, char *url) {
+    char *filename = stringJoin(url, ".txt");
+    struct stat info;
+
+    slot->stored = reader->store == NULL ? NOT_STORED : findStoredPage(reader->store, url);
+    slot->done = 0;
+    slot->size = 0;
+    slot->contents = NULL;
+
+    // A stored page is only opened if its file has changed since it was packed
+    if (slot->stored != NOT_STORED &&
+        (stat(filename, &info) != 0 || isStoredPageCurrent(reader->store, slot->stored, &info))) {
+        free(filename);
+        slot->fd = -1;
+        slot->contents = getStoredContents(reader->store, slot->stored);
+        slot->size = slot->done = reader->store->pages[slot->stored].size;
+        return SLOT_READY;
+    }
+    slot->stored = NOT_STORED;
+
+    slot->fd = open(filename, O_RDONLY);
+    free(filename);
+    if (slot->fd >= 0 && fstat(slot->fd, &info) != 0) {
+        close(slot->fd);
+        slot->fd = -1;
+    }
+    if (slot->fd < 0) return SLOT_FAILED;
+
+    slot->size = info.st_size;
+    slot->contents = malloc(slot->size + 1);
+    if (slot->size == 0) {
+        close(slot->fd);
+        return SLOT_READY;
+    }
+
+    return SLOT_READING;
+}
+
+// Takes the next page not yet started and reads it, as long as it fits in
+// the window, until every page has been read
+static void *readPages(void *arg) {
+    pageReader reader = arg;
+
+    pthread_mutex_lock(&reader->lock);
+    while (1) {
+        while (!reader->stopping && reader->numStarted < reader->numUrls &&
+            reader->numStarted >= reader->numReturned + READ_WINDOW) {
+            pthread_cond_wait(&reader->changed, &reader->lock);
+        }
+        if (reader->stopping || reader->numStarted == reader->numUrls) break;
+
+        int page = reader->numStarted;
+        struct pageSlot *slot = &reader->slots[page % READ_WINDOW];
+        slot->state = SLOT_READING;
+        reader->numStarted++;
+        pthread_mutex_unlock(&reader->lock);
+
+        int state = readWholePage(reader, slot, reader->urls[page]);
+
+        // nextPage waits on the state, so it only changes under the lock
+        pthread_mutex_lock(&reader->lock);
+        slot->state = state;
+        pthread_cond_broadcast(&reader->changed);
+    }
+    pthread_mutex_unlock(&reader->lock);
+
+    return NULL;
+}
+
+// Reads a page into its slot with pread, and returns the state the slot
+// should then be in, without setting it
+static int readWholePage(pageReader reader, struct pageSlot *slot, char *url) {
+    int state = openPageFile(reader, slot, url);
+    if (state != SLOT_READING) return state;
+
+    while (slot->done < slot->size) {
+        ssize_t length = pread(slot->fd, slot->contents + slot->done, slot->size - slot->done,
+            slot->done);
+        if (length < 0) {
+            close(slot->fd);
+            return SLOT_FAILED;
+        }
+        if (length == 0) break;
+        slot->done += length;
+    }
+
+    close(slot->fd);
+    return SLOT_READY;
+}
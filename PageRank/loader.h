@@ -0,0 +1,80 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include <linux/io_uring.h>
+
+#include "docstore.h"
+
+// Number of pages read ahead of the page being processed
+#define READ_WINDOW 64
+
+// Threads reading pages when io_uring is not available
+#define READER_THREADS 8
+
+// How a page reader may read pages: through io_uring if the kernel allows
+// it, and from the page store for pages packed there
+#define READ_URING 1
+#define READ_STORED 2
+
+typedef struct _pageReader *pageReader;
+
+// Where the read of one page in the window has got to
+struct pageSlot {
+    int state;
+    int stored;             // Document ID in the page store, or NOT_STORED
+    int fd;
+    char *contents;
+    size_t size;
+    size_t done;
+};
+
+// The queues shared with the kernel by an io_uring instance
+struct uringQueues {
+    int fd;
+    unsigned *sqTail;
+    unsigned *sqMask;
+    unsigned *sqArray;
+    struct io_uring_sqe *sqes;
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned *cqMask;
+    struct io_uring_cqe *cqes;
+    void *sqRing;
+    size_t sqRingSize;
+    void *cqRing;
+    size_t cqRingSize;
+    size_t sqesSize;
+    int numQueued;
+};
+
+// Reads the pages of a list of URLs in order, while the reads of the pages
+// after the one being processed are already under way. Reads are submitted
+// together through io_uring, or made by a pool of threads if io_uring
+// cannot be used. Pages in the page store are taken from there instead
+struct _pageReader {
+    char **urls;
+    int numUrls;
+    int numStarted;         // Pages whose reads have been started
+    int numReturned;        // Pages returned by nextPage
+    char *current;          // Contents of the page last returned, if read
+    int currentStored;      // Store ID of the page last returned
+    pageStore store;
+    struct pageSlot slots[READ_WINDOW];
+    int uring;              // Whether reads go through io_uring
+    struct uringQueues queues;
+    pthread_t threads[READER_THREADS];
+    int numThreads;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    int stopping;
+};
+
+pageReader openPageReader(char **urls, int numUrls, int flags);
+char *nextPage(pageReader reader);
+char *nextPageSection(pageReader reader, char *section);
+char *getPageSection(pageReader reader, char *section);
+void closePageReader(pageReader reader);
+
+#endif
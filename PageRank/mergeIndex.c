@@ -0,0 +1,28 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "indexer.h"
+#include "segments.h"
+
+int main(int argc, char *argv[]) {
+    int all = 0;
+
+    // -a merges every segment into one, instead of following the merge policy
+    if (argc > 1 && strcmp(argv[1], "-a") == 0) {
+        all = 1;
+    } else if (argc > 1) {
+        printf("ERROR: Unknown option '%s'\n", argv[1]);
+        printf("mergeIndex [-a]\n");
+        exit(1);
+    }
+
+    int numMerges = 0;
+    while (mergeSegments(all, defaultThreads())) {
+        numMerges++;
+        if (all) break;
+    }
+
+    printf("%d merges\n", numMerges);
+    return 0;
+}
@@ -0,0 +1,18 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "docstore.h"
+
+int main(int argc, char *argv[]) {
+    if (argc > 1) {
+        printf("ERROR: Unknown option '%s'\n", argv[1]);
+        printf("packPages\n");
+        exit(1);
+    }
+
+    // Pack every page of the collection, so builds map the pages instead
+    // of opening a file for each one
+    writePageStore("collection.txt", PAGE_STORE);
+
+    return 0;
+}
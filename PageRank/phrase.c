@@ -0,0 +1,284 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "phrase.h"
+#include "text.h"
+
+static int countOccurrences(int **positions, int *lengths, int numWords, int slop);
+static int gallop(int *values, int length, int start, int target);
+static int gallopDocs(struct positionalDoc *docs, int length, int start, unsigned int target);
+
+// Returns whether a cleaned search term is a phrase of several words
+int isPhrase(char *term) {
+    return strchr(term, ' ') != NULL;
+}
+
+// Cleans each word of a phrase query and joins them with single spaces.
+// A trailing ~N, as in "quick fox~2", is kept as the phrase's slop
+char *cleanPhrase(char *string) {
+    int len = strlen(string);
+    int slop = 0;
+
+    // Look for a slop of digits after the last tilde
+    char *tilde = strrchr(string, PHRASE_SLOP);
+    if (tilde != NULL && tilde[1] != '\0') {
+        int digits = 1;
+        for (int i = 1; tilde[i] != '\0'; i++) {
+            if (!isdigit((unsigned char)tilde[i])) digits = 0;
+        }
+
+        if (digits) {
+            slop = atoi(tilde + 1);
+            len = tilde - string;
+        }
+    }
+
+    char *words = calloc(len + 1, sizeof(char));
+    strncpy(words, string, len);
+    stringList list = splitString(words, " ");
+
+    char *new = calloc(len + BUFFER_SIZE, sizeof(char));
+    int numWords = 0;
+    for (stringNode n = list->start; n != NULL; n = n->next) {
+        char *cleaned = cleanString(n->string);
+
+        // Words with no letters or digits are left out of the phrase
+        if (cleaned[0] != '\0') {
+            if (numWords > 0) strcat(new, " ");
+            strcat(new, cleaned);
+            numWords++;
+        }
+        free(cleaned);
+    }
+
+    if (numWords > 1 && slop > 0) {
+        sprintf(new + strlen(new), "%c%d", PHRASE_SLOP, slop);
+    }
+
+    free(words);
+    freeStringList(list);
+    return new;
+}
+
+// Splits a phrase made by cleanPhrase into its words and slop
+phrase parsePhrase(char *term) {
+    phrase p = malloc(sizeof(struct _phrase));
+    char *words = stringJoin(term, "");
+    p->slop = 0;
+
+    char *tilde = strchr(words, PHRASE_SLOP);
+    if (tilde != NULL) {
+        p->slop = atoi(tilde + 1);
+        *tilde = '\0';
+    }
+
+    stringList list = splitString(words, " ");
+    p->numWords = 0;
+    p->words = calloc(stringListLength(list), sizeof(char *));
+    for (stringNode n = list->start; n != NULL; n = n->next) {
+        p->words[p->numWords] = stringJoin(n->string, "");
+        p->numWords++;
+    }
+
+    free(words);
+    freeStringList(list);
+    return p;
+}
+
+// Frees the memory occupied by a phrase
+void freePhrase(phrase p) {
+    for (int i = 0; i < p->numWords; i++) free(p->words[i]);
+    free(p->words);
+    free(p);
+}
+
+// Finds the documents containing a phrase. Documents are found by stepping
+// through those of the phrase's rarest word and galloping ahead in the
+// others, so the work grows with the rarest word's document frequency
+phraseMatches matchPhrase(invertedIndex index, positionalIndex positions, char *term) {
+    phrase p = parsePhrase(term);
+    int numWords = p->numWords;
+
+    phraseMatches matches = malloc(sizeof(struct _phraseMatches));
+    matches->numDocs = 0;
+    matches->docs = NULL;
+    matches->counts = NULL;
+
+    struct positionalDoc **docs = calloc(numWords, sizeof(struct positionalDoc *));
+    int *docFreqs = calloc(numWords, sizeof(int));
+    int *cursors = calloc(numWords, sizeof(int));
+    int **wordPositions = calloc(numWords, sizeof(int *));
+    int *lengths = calloc(numWords, sizeof(int));
+    int *capacities = calloc(numWords, sizeof(int));
+
+    int rarest = 0;
+    int found = numWords > 0;
+    for (int w = 0; w < numWords; w++) {
+        int t = findTerm(index, p->words[w]);
+        if (t == NO_TERM) {
+            found = 0;
+            break;
+        }
+
+        docs[w] = positions->docs + positions->terms[t].docs;
+        docFreqs[w] = positions->terms[t].docFreq;
+        if (docFreqs[w] < docFreqs[rarest]) rarest = w;
+    }
+
+    if (found) {
+        matches->docs = calloc(docFreqs[rarest], sizeof(int));
+        matches->counts = calloc(docFreqs[rarest], sizeof(int));
+    }
+
+    while (found && cursors[rarest] < docFreqs[rarest]) {
+        unsigned int doc = docs[rarest][cursors[rarest]].doc;
+        unsigned int next = doc;
+
+        // Move every other word up to the candidate document
+        for (int w = 0; w < numWords && next == doc; w++) {
+            if (w == rarest) continue;
+            cursors[w] = gallopDocs(docs[w], docFreqs[w], cursors[w], doc);
+
+            if (cursors[w] == docFreqs[w]) found = 0;
+            else next = docs[w][cursors[w]].doc;
+        }
+
+        if (!found) break;
+
+        // Skip the rarest word ahead when another word does not contain it
+        if (next != doc) {
+            cursors[rarest] = gallopDocs(docs[rarest], docFreqs[rarest], cursors[rarest], next);
+            continue;
+        }
+
+        for (int w = 0; w < numWords; w++) {
+            int entry = docs[w] + cursors[w] - positions->docs;
+            int count = countPositions(positions, entry);
+
+            if (count > capacities[w]) {
+                capacities[w] = count;
+                wordPositions[w] = realloc(wordPositions[w], count * sizeof(int));
+            }
+            lengths[w] = readPositions(positions, entry, wordPositions[w]);
+        }
+
+        int count = countOccurrences(wordPositions, lengths, numWords, p->slop);
+        if (count > 0) {
+            matches->docs[matches->numDocs] = doc;
+            matches->counts[matches->numDocs] = count;
+            matches->numDocs++;
+        }
+
+        cursors[rarest]++;
+    }
+
+    for (int w = 0; w < numWords; w++) free(wordPositions[w]);
+    free(docs);
+    free(docFreqs);
+    free(cursors);
+    free(wordPositions);
+    free(lengths);
+    free(capacities);
+    freePhrase(p);
+    return matches;
+}
+
+// Returns how many times a phrase starts in a document
+int getPhraseCount(phraseMatches matches, int doc) {
+    int low = 0;
+    int high = matches->numDocs;
+
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (matches->docs[mid] < doc) low = mid + 1;
+        else high = mid;
+    }
+
+    if (low < matches->numDocs && matches->docs[low] == doc) return matches->counts[low];
+    return 0;
+}
+
+// Frees the memory occupied by phrase matches
+void freePhraseMatches(phraseMatches matches) {
+    free(matches->docs);
+    free(matches->counts);
+    free(matches);
+}
+
+// Counts the positions of the first word that start the phrase in one
+// document. From each start, every later word takes its first position
+// after the word before, which keeps the phrase as short as possible
+static int countOccurrences(int **positions, int *lengths, int numWords, int slop) {
+    int *cursors = calloc(numWords, sizeof(int));
+    int count = 0;
+
+    for (int s = 0; s < lengths[0]; s++) {
+        int start = positions[0][s];
+        int prev = start;
+        int matched = 1;
+
+        for (int w = 1; w < numWords && matched; w++) {
+            // Later starts only ever need later positions, so keep cursors
+            cursors[w] = gallop(positions[w], lengths[w], cursors[w], prev + 1);
+
+            // No later start can match once a word runs out of positions
+            if (cursors[w] == lengths[w]) {
+                free(cursors);
+                return count;
+            }
+
+            prev = positions[w][cursors[w]];
+            if (prev - start - w > slop) matched = 0;
+        }
+
+        if (matched) count++;
+    }
+
+    free(cursors);
+    return count;
+}
+
+// Returns the first index from start whose value is not below target,
+// doubling the step until it is passed and then binary searching
+static int gallop(int *values, int length, int start, int target) {
+    if (start >= length || values[start] >= target) return start;
+
+    int low = start;
+    int step = 1;
+    while (low + step < length && values[low + step] < target) {
+        low += step;
+        step *= 2;
+    }
+
+    int high = low + step < length ? low + step : length;
+    while (low + 1 < high) {
+        int mid = (low + high) / 2;
+        if (values[mid] < target) low = mid;
+        else high = mid;
+    }
+
+    return high;
+}
+
+// Gallops through document entries in the same way as gallop
+static int gallopDocs(struct positionalDoc *docs, int length, int start, unsigned int target) {
+    if (start >= length || docs[start].doc >= target) return start;
+
+    int low = start;
+    int step = 1;
+    while (low + step < length && docs[low + step].doc < target) {
+        low += step;
+        step *= 2;
+    }
+
+    int high = low + step < length ? low + step : length;
+    while (low + 1 < high) {
+        int mid = (low + high) / 2;
+        if (docs[mid].doc < target) low = mid;
+        else high = mid;
+    }
+
+    return high;
+}
@@ -0,0 +1,36 @@
+#ifndef PHRASE_H
+#define PHRASE_H
+
+#include "index.h"
+
+#define PHRASE_SLOP '~'
+
+typedef struct _phrase *phrase;
+typedef struct _phraseMatches *phraseMatches;
+
+// The cleaned words of a phrase query. Slop is how many other words may
+// appear between the words of the phrase in total, with 0 for an exact phrase
+struct _phrase {
+    int numWords;
+    char **words;
+    int slop;
+};
+
+// The documents containing a phrase, in ascending ID order, with how many
+// times the phrase starts in each
+struct _phraseMatches {
+    int numDocs;
+    int *docs;
+    int *counts;
+};
+
+int isPhrase(char *term);
+char *cleanPhrase(char *string);
+phrase parsePhrase(char *term);
+void freePhrase(phrase p);
+
+phraseMatches matchPhrase(invertedIndex index, positionalIndex positions, char *term);
+int getPhraseCount(phraseMatches matches, int doc);
+void freePhraseMatches(phraseMatches matches);
+
+#endif
@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pipeline.h"
+#include "indexer.h"
+
+#define INITIAL_VERTEXES 64
+
+// Builds the link graph of a document table from a link table
+struct graphTask {
+    docTable docs;
+    linkTable links;
+    graph linkGraph;
+};
+
+static void *buildLinkGraph(void *arg);
+
+// Reads every page of a collection once, indexing its Section-2 words and
+// adding its Section-1 links to a link graph. The indexing threads read
+// the pages, and a graph thread adds each page's links in collection order
+// as they are read. Writes the index files as buildInvertedIndex does, and
+// returns the graph
+graph ingestCollection(char *collection, char *textOutput, char *binaryOutput,
+    char *forwardOutput, char *positionalOutput, int numThreads) {
+    docTable docs = readDocTable(collection);
+
+    struct graphTask task;
+    task.docs = docs;
+    task.links = newLinkTable(docs->numDocs);
+    task.linkGraph = newGraph(INITIAL_VERTEXES);
+
+    // Without a thread of its own, the graph is built once indexing is done
+    pthread_t thread;
+    int started = pthread_create(&thread, NULL, buildLinkGraph, &task) == 0;
+
+    buildIndex(docs, textOutput, binaryOutput, forwardOutput, positionalOutput, numThreads,
+        task.links);
+
+    if (started) pthread_join(thread, NULL);
+    else buildLinkGraph(&task);
+
+    freeLinkTable(task.links);
+    freeDocTable(docs);
+    return task.linkGraph;
+}
+
+// Adds the links of each document to the graph in ID order, waiting for
+// each document's page to be read
+static void *buildLinkGraph(void *arg) {
+    struct graphTask *task = arg;
+
+    for (int id = 0; id < task->docs->numDocs; id++) {
+        char *linksText = takeLinks(task->links, id);
+        addPageLinks(task->linkGraph, task->docs->urls[id], linksText);
+        free(linksText);
+    }
+
+    return NULL;
+}
+
+// Allocates and returns a new link table with no links put in
+linkTable newLinkTable(int numDocs) {
+    linkTable table = malloc(sizeof(struct _linkTable));
+    table->numDocs = numDocs;
+    table->links = calloc(numDocs, sizeof(char *));
+    pthread_mutex_init(&table->lock, NULL);
+    pthread_cond_init(&table->added, NULL);
+    return table;
+}
+
+// Puts a document's links in a link table, which takes ownership of them
+void putLinks(linkTable table, int id, char *linksText) {
+    pthread_mutex_lock(&table->lock);
+    table->links[id] = linksText;
+    pthread_cond_broadcast(&table->added);
+    pthread_mutex_unlock(&table->lock);
+}
+
+// Takes a document's links out of a link table, waiting until they have
+// been put in. The caller frees them
+char *takeLinks(linkTable table, int id) {
+    pthread_mutex_lock(&table->lock);
+    while (table->links[id] == NULL) pthread_cond_wait(&table->added, &table->lock);
+
+    char *linksText = table->links[id];
+    table->links[id] = NULL;
+    pthread_mutex_unlock(&table->lock);
+
+    return linksText;
+}
+
+// Frees a link table, along with any links not taken
+void freeLinkTable(linkTable table) {
+    for (int i = 0; i < table->numDocs; i++) free(table->links[i]);
+    free(table->links);
+    pthread_mutex_destroy(&table->lock);
+    pthread_cond_destroy(&table->added);
+    free(table);
+}
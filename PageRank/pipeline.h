@@ -0,0 +1,28 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <pthread.h>
+
+#include "graph.h"
+
+typedef struct _linkTable *linkTable;
+
+// The Section-1 links of each document by ID, put in by the threads that
+// index the documents and taken in ID order by the thread that builds the
+// link graph. A document's links are NULL until they are put in
+struct _linkTable {
+    int numDocs;
+    char **links;
+    pthread_mutex_t lock;
+    pthread_cond_t added;
+};
+
+linkTable newLinkTable(int numDocs);
+void putLinks(linkTable table, int id, char *linksText);
+char *takeLinks(linkTable table, int id);
+void freeLinkTable(linkTable table);
+
+graph ingestCollection(char *collection, char *textOutput, char *binaryOutput,
+    char *forwardOutput, char *positionalOutput, int numThreads);
+
+#endif
@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "postings.h"
+
+// Writes a value as a varint, 7 bits per byte with the high bit set on
+// every byte but the last, and returns the number of bytes written
+int encodeVarint(unsigned int value, unsigned char *out) {
+    int length = 0;
+
+    while (value >= 0x80) {
+        out[length] = (value & 0x7F) | 0x80;
+        value >>= 7;
+        length++;
+    }
+
+    out[length] = value;
+    return length + 1;
+}
+
+// Reads a varint and moves the input pointer past it
+unsigned int decodeVarint(unsigned char **in) {
+    unsigned char *p = *in;
+    unsigned int value = *p & 0x7F;
+    int shift = 7;
+
+    while (*p & 0x80) {
+        p++;
+        value |= (unsigned int)(*p & 0x7F) << shift;
+        shift += 7;
+    }
+
+    *in = p + 1;
+    return value;
+}
+
+// Writes an ascending list of document IDs as varint gaps between
+// consecutive IDs, and returns the number of bytes written.
+// The output needs room for length * MAX_VARINT bytes
+int encodePostings(int *ids, int length, unsigned char *out) {
+    int size = 0;
+    int prev = 0;
+
+    for (int i = 0; i < length; i++) {
+        size += encodeVarint(ids[i] - prev, out + size);
+        prev = ids[i];
+    }
+
+    return size;
+}
+
+// Reads length document IDs written by encodePostings, and returns
+// a pointer to the byte after them
+unsigned char *decodePostings(unsigned char *in, int length, int *ids) {
+    int prev = 0;
+
+    for (int i = 0; i < length; i++) {
+        prev += decodeVarint(&in);
+        ids[i] = prev;
+    }
+
+    return in;
+}
+
+// Returns the most bytes encodeSkipPostings can write for length IDs
+int skipPostingsBound(int length) {
+    return length * MAX_VARINT + (length / SKIP_INTERVAL + 1) * SKIP_SIZE;
+}
+
+// Returns the number of skip pointers stored with length IDs. Every block of
+// SKIP_INTERVAL IDs after the first has one
+static int countSkips(int length) {
+    return length == 0 ? 0 : (length - 1) / SKIP_INTERVAL;
+}
+
+// Writes an ascending list of document IDs as a table of skip pointers
+// followed by the same varint gaps as encodePostings. Each skip pointer
+// holds the last ID before its block and the block's offset from the start
+// of the gaps, both as 4-byte integers. Returns the number of bytes written
+int encodeSkipPostings(int *ids, int length, unsigned char *out) {
+    int numSkips = countSkips(length);
+    unsigned char *gaps = out + numSkips * SKIP_SIZE;
+    int size = 0;
+    int prev = 0;
+
+    for (int i = 0; i < length; i++) {
+        if (i > 0 && i % SKIP_INTERVAL == 0) {
+            unsigned int skip[2] = {prev, size};
+            memcpy(out + (i / SKIP_INTERVAL - 1) * SKIP_SIZE, skip, SKIP_SIZE);
+        }
+
+        size += encodeVarint(ids[i] - prev, gaps + size);
+        prev = ids[i];
+    }
+
+    return numSkips * SKIP_SIZE + size;
+}
+
+// Returns where the gaps start in postings written by encodeSkipPostings
+unsigned char *getPostingGaps(unsigned char *in, int length) {
+    return in + countSkips(length) * SKIP_SIZE;
+}
+
+// Reads skip pointer number skip, for the block after it
+static void readSkip(struct postingCursor *cursor, int skip, unsigned int *lastDoc,
+    unsigned int *offset) {
+    unsigned int entry[2];
+    memcpy(entry, cursor->skips + skip * SKIP_SIZE, SKIP_SIZE);
+    *lastDoc = entry[0];
+    *offset = entry[1];
+}
+
+// Places a cursor before the first of length postings written by
+// encodeSkipPostings
+void openCursor(struct postingCursor *cursor, unsigned char *postings, int length) {
+    cursor->skips = postings;
+    cursor->numSkips = countSkips(length);
+    cursor->gaps = getPostingGaps(postings, length);
+    cursor->next = cursor->gaps;
+    cursor->length = length;
+    cursor->index = 0;
+    cursor->doc = -1;
+}
+
+// Moves a cursor to its next posting and returns the document ID
+int nextPosting(struct postingCursor *cursor) {
+    if (cursor->index == cursor->length) {
+        cursor->doc = END_POSTING;
+        return END_POSTING;
+    }
+
+    int prev = cursor->index == 0 ? 0 : cursor->doc;
+    cursor->doc = prev + decodeVarint(&cursor->next);
+    cursor->index++;
+    return cursor->doc;
+}
+
+// Moves a cursor to the first posting at or after target, and returns its
+// document ID. Skip pointers are galloped through from the current block,
+// then the block holding the target is decoded
+int seekPosting(struct postingCursor *cursor, int target) {
+    if (cursor->doc >= target) return cursor->doc;
+
+    // Block b is reached through skip b - 1, whose last ID must be below
+    // the target for every ID before the block to be below it too
+    int block = cursor->index / SKIP_INTERVAL;
+    int low = block;
+    int step = 1;
+    unsigned int lastDoc;
+    unsigned int offset;
+
+    while (low + step <= cursor->numSkips) {
+        readSkip(cursor, low + step - 1, &lastDoc, &offset);
+        if ((int)lastDoc >= target) break;
+        low += step;
+        step *= 2;
+    }
+
+    int high = low + step <= cursor->numSkips ? low + step : cursor->numSkips + 1;
+    while (low + 1 < high) {
+        int mid = (low + high) / 2;
+        readSkip(cursor, mid - 1, &lastDoc, &offset);
+        if ((int)lastDoc < target) low = mid;
+        else high = mid;
+    }
+
+    if (low > block) {
+        readSkip(cursor, low - 1, &lastDoc, &offset);
+        cursor->next = cursor->gaps + offset;
+        cursor->index = low * SKIP_INTERVAL;
+        cursor->doc = lastDoc;
+    }
+
+    while (cursor->doc < target) nextPosting(cursor);
+    return cursor->doc;
+}
+
+// Returns the block of postings that seeking to target would stop in,
+// without moving the cursor, and sets lastDoc to the block's last document
+// ID. The last block runs to the end of the postings
+int findPostingBlock(struct postingCursor *cursor, int target, int *lastDoc) {
+    // Skip b holds the last ID of block b, so find the first skip whose
+    // last ID is not below the target
+    int low = cursor->doc >= target && cursor->index > 0 ? (cursor->index - 1) / SKIP_INTERVAL
+        : cursor->index / SKIP_INTERVAL;
+    int high = cursor->numSkips;
+    unsigned int skipDoc;
+    unsigned int offset;
+
+    while (low < high) {
+        int mid = (low + high) / 2;
+        readSkip(cursor, mid, &skipDoc, &offset);
+        if ((int)skipDoc < target) low = mid + 1;
+        else high = mid;
+    }
+
+    if (low < cursor->numSkips) {
+        readSkip(cursor, low, &skipDoc, &offset);
+        *lastDoc = skipDoc;
+    } else {
+        *lastDoc = END_POSTING - 1;
+    }
+
+    return low;
+}
@@ -0,0 +1,41 @@
+#ifndef POSTINGS_H
+#define POSTINGS_H
+
+// Largest number of bytes a single varint can take
+#define MAX_VARINT 5
+
+// Number of postings in each block that a skip pointer can jump to
+#define SKIP_INTERVAL 64
+#define SKIP_SIZE 8
+
+// Document ID returned once a cursor has passed its last posting
+#define END_POSTING 0x7FFFFFFF
+
+// A position within a list of postings with skip pointers. doc is the last
+// document read, -1 before the first and END_POSTING after the last
+struct postingCursor {
+    unsigned char *skips;
+    int numSkips;
+    unsigned char *gaps;
+    unsigned char *next;
+    int length;
+    int index;
+    int doc;
+};
+
+int encodeVarint(unsigned int value, unsigned char *out);
+unsigned int decodeVarint(unsigned char **in);
+
+int encodePostings(int *ids, int length, unsigned char *out);
+unsigned char *decodePostings(unsigned char *in, int length, int *ids);
+
+int skipPostingsBound(int length);
+int encodeSkipPostings(int *ids, int length, unsigned char *out);
+unsigned char *getPostingGaps(unsigned char *in, int length);
+
+void openCursor(struct postingCursor *cursor, unsigned char *postings, int length);
+int nextPosting(struct postingCursor *cursor);
+int seekPosting(struct postingCursor *cursor, int target);
+int findPostingBlock(struct postingCursor *cursor, int target, int *lastDoc);
+
+#endif
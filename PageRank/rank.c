@@ -0,0 +1,344 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "rank.h"
+#include "impact.h"
+
+#define MAX_LINE 1024
+
+// How a search program ranks, as weights of the hybrid ranking, and
+// whether it writes each URL's tf-idf
+struct rankPreset {
+    char *program;
+    struct rankWeights weights;
+    int printScores;
+};
+
+// searchPagerank ranks by terms found plus pagerank, and searchTfIdf by
+// terms found plus tf-idf
+static struct rankPreset presets[] = {
+    {RANK_PAGERANK, {1, 0, 1}, 0},
+    {RANK_TFIDF, {1, 1, 0}, 1},
+};
+
+#define NUM_PRESETS (int)(sizeof(presets) / sizeof(presets[0]))
+
+static struct rankPreset *findPreset(char *program);
+static unsigned int hashDocUrls(segmentSet set);
+static char *checkRankIndexes(struct rankIndexes *indexes, int impact);
+
+// Loads every index that exists for ranking searches. Returns an error
+// message, with nothing loaded, if an index cannot be opened
+char *loadRankIndexes(struct rankIndexes *indexes) {
+    int impact = access(BASE_IMPACT, R_OK) == 0;
+
+    indexes->set = openSegments(access(BASE_POSITIONAL, R_OK) == 0);
+    indexes->pageranks = indexes->set == NULL ? NULL : openPagerankIndex(indexes->set);
+    indexes->impacts = impact ? openImpactIndex(BASE_IMPACT) : NULL;
+    return checkRankIndexes(indexes, impact);
+}
+
+// Loads only the indexes one search ranked as the named program needs.
+// Returns an error message, with nothing loaded, if one cannot be opened
+char *loadSearchIndexes(struct rankIndexes *indexes, char *program, struct searchOptions *options,
+    stringList searchTerms) {
+    struct rankWeights *weights = getRankWeights(program, options);
+    int impact = options->impact && access(BASE_IMPACT, R_OK) == 0;
+
+    indexes->set = openSegments(hasPhrase(searchTerms) && access(BASE_POSITIONAL, R_OK) == 0);
+    indexes->pageranks = indexes->set != NULL && weights != NULL && weights->pagerank != 0 ?
+        openPagerankIndex(indexes->set) : NULL;
+    indexes->impacts = impact ? openImpactIndex(BASE_IMPACT) : NULL;
+    return checkRankIndexes(indexes, impact);
+}
+
+// Frees the indexes loaded for ranking searches
+void freeRankIndexes(struct rankIndexes *indexes) {
+    closeImpactIndex(indexes->impacts);
+    closePagerankIndex(indexes->pageranks);
+    closeSegments(indexes->set);
+}
+
+// Finds the pagerank of every document by ID. The binary file is mapped if
+// it was written for the documents' current IDs, and otherwise the list is
+// read. Returns NULL if neither exists
+pagerankIndex openPagerankIndex(segmentSet set) {
+    pagerankIndex pageranks = malloc(sizeof(struct _pagerankIndex));
+    pageranks->map = NULL;
+    pageranks->size = 0;
+
+    if (access(PAGERANK_INDEX, R_OK) == 0) {
+        size_t size;
+        void *map = mapFile(PAGERANK_INDEX, sizeof(struct pagerankHeader), &size);
+        struct pagerankHeader *header = map;
+
+        if (map != NULL && header->magic == PAGERANK_MAGIC && header->version == PAGERANK_VERSION &&
+            header->numIds == (unsigned int)set->numIds &&
+            size == sizeof(struct pagerankHeader) + set->numIds * sizeof(double) &&
+            header->urlHash == hashDocUrls(set)) {
+            pageranks->map = map;
+            pageranks->size = size;
+            pageranks->ranks = (double *)(header + 1);
+            return pageranks;
+        }
+
+        if (map != NULL) munmap(map, size);
+    }
+
+    pageranks->ranks = readPageranks(set, PAGERANK_LIST);
+    if (pageranks->ranks == NULL) {
+        free(pageranks);
+        return NULL;
+    }
+    return pageranks;
+}
+
+// Unmaps or frees the pagerank of every document
+void closePagerankIndex(pagerankIndex pageranks) {
+    if (pageranks == NULL) return;
+    if (pageranks->map != NULL) munmap(pageranks->map, pageranks->size);
+    else free(pageranks->ranks);
+    free(pageranks);
+}
+
+// Reads the pagerank of every live document listed in a pagerank list,
+// indexed by document ID. Returns NULL if the list cannot be read
+double *readPageranks(segmentSet set, char *pagerankList) {
+    char buffer[MAX_LINE];
+    FILE *rank = fopen(pagerankList, "r");
+    if (rank == NULL) return NULL;
+
+    double *pageranks = calloc(set->numIds + 1, sizeof(double));
+    while (fgets(buffer, MAX_LINE, rank)) {
+        // Split line into string list
+        stringList line = splitString(buffer, ", ");
+
+        if (line->start != NULL) {
+            // First word in string list = url name
+            int doc;
+            int s = findLiveDoc(set, line->start->string, &doc);
+
+            // Last word in string list = pagerank value
+            if (s != NO_SEGMENT) pageranks[set->firstIds[s] + doc] += atof(line->end->string);
+        }
+
+        freeStringList(line);
+    }
+
+    fclose(rank);
+    return pageranks;
+}
+
+// Returns a key naming a search and how it is ranked, the same for every
+// search ranked the same: the program, options and weights, then the
+// distinct terms as a query holds them, separated by tabs
+char *searchKey(char *program, struct searchOptions *options, stringList searchTerms) {
+    char **terms = calloc(stringListLength(searchTerms) + 1, sizeof(char *));
+    int numWords;
+    int numTerms = normaliseTerms(searchTerms, terms, &numWords);
+
+    char *key;
+    size_t size;
+    FILE *out = open_memstream(&key, &size);
+    fprintf(out, "%s\t%d\t%d", program, options->minMatch, options->impact);
+
+    struct rankWeights *weights = getRankWeights(program, options);
+    if (weights != NULL) fprintf(out, "\t%.17g,%.17g,%.17g", weights->count, weights->tfIdf, weights->pagerank);
+    for (int t = 0; t < numTerms; t++) fprintf(out, "\t%s", terms[t]);
+    fclose(out);
+
+    free(terms);
+    return key;
+}
+
+// Writes the pagerank of each URL indexed by the ID of its live document,
+// as the list prints it so that either file ranks the same. Nothing is
+// written if no index has been built to number the documents
+void writePagerankIndex(char **urls, double *ranks, int numUrls, char *output) {
+    if (access(BASE_INDEX, R_OK) != 0) return;
+
+    segmentSet set = openSegments(0);
+    if (set == NULL) {
+        printf("%s\n", getIndexError());
+        exit(1);
+    }
+    double *byId = calloc(set->numIds + 1, sizeof(double));
+    char printed[64];
+
+    for (int i = 0; i < numUrls; i++) {
+        int doc;
+        int s = findLiveDoc(set, urls[i], &doc);
+        if (s == NO_SEGMENT) continue;
+
+        snprintf(printed, sizeof(printed), PAGERANK_FORMAT, ranks[i]);
+        byId[set->firstIds[s] + doc] = atof(printed);
+    }
+
+    FILE *file = openReplacement(output);
+    if (file == NULL) {
+        printf("ERROR: Could not write pageranks to file '%s'\n", output);
+        exit(1);
+    }
+
+    struct pagerankHeader header;
+    header.magic = PAGERANK_MAGIC;
+    header.version = PAGERANK_VERSION;
+    header.numIds = set->numIds;
+    header.urlHash = hashDocUrls(set);
+    fwrite(&header, sizeof(struct pagerankHeader), 1, file);
+    fwrite(byId, sizeof(double), set->numIds, file);
+    commitReplacement(file, output);
+
+    free(byId);
+    closeSegments(set);
+}
+
+// Ranks a search as the named program would, or by the weights given
+// instead, and writes its results. Returns an error message, with nothing
+// written, if it cannot be run
+char *rankSearch(char *program, struct rankIndexes *indexes, struct searchOptions *options,
+    stringList searchTerms, FILE *out) {
+    struct rankPreset *preset = findPreset(program);
+    if (preset == NULL) return "ERROR: Unknown search program";
+
+    struct rankWeights *weights = options->weighted ? &options->weights : &preset->weights;
+    return rankHybrid(indexes, weights, options, searchTerms, preset->printScores, out);
+}
+
+// Returns the weights a program ranks by unless others are given
+struct rankWeights *getRankWeights(char *program, struct searchOptions *options) {
+    if (options->weighted) return &options->weights;
+
+    struct rankPreset *preset = findPreset(program);
+    return preset == NULL ? NULL : &preset->weights;
+}
+
+// Writes the URLs matching a search, best first, ranked by adding up the
+// weighted number of terms found, tf-idf and pagerank of each. Their
+// tf-idf is written too if printScores is set. Returns an error message,
+// with nothing written, if the search cannot be run
+char *rankHybrid(struct rankIndexes *indexes, struct rankWeights *weights,
+    struct searchOptions *options, stringList searchTerms, int printScores, FILE *out) {
+    segmentSet set = indexes->set;
+    int tfIdfOnly = weights->count == 1 && weights->tfIdf == 1 && weights->pagerank == 0;
+
+    if (weights->pagerank != 0 && indexes->pageranks == NULL) {
+        return "ERROR: Could not open pagerank list '" PAGERANK_LIST "'";
+    }
+    if (options->impact && !tfIdfOnly) return "ERROR: -impact is only supported when ranking by tf-idf";
+    if (options->impact && indexes->impacts == NULL) return "ERROR: Could not open index file '" BASE_IMPACT "'";
+    if (hasPhrase(searchTerms) && set->segments[0]->positions == NULL) return PHRASE_INDEX_ERROR;
+
+    query q = newQuery(searchTerms, set, options->minMatch);
+    char *error = options->impact ? checkImpactQuery(q, set, indexes->impacts) : NULL;
+    if (error != NULL) {
+        freeQuery(q, set);
+        return error;
+    }
+
+    // Calculate idf for every term given, unless tf-idf does not count
+    double *idfs = calloc(q->numTerms, sizeof(double));
+    for (int t = 0; t < q->numTerms && weights->tfIdf != 0; t++) {
+        if (q->phrases[t] != NULL) idfs[t] = calculatePhraseIdf(set, q->phrases[t]);
+        else idfs[t] = calculateIdf(set, q->terms[t]);
+    }
+
+    // Ranking by tf-idf alone has faster ways to find the best documents.
+    // When any one term will do, skip the documents that cannot make the
+    // results. Otherwise only the documents with enough terms are left to
+    // score, so score them all
+    topDocs top;
+    if (options->impact) top = findTopImpact(q, set, indexes->impacts, idfs, NUM_RESULTS);
+    else if (tfIdfOnly && q->found == NULL) top = findTopTfIdf(q, set, idfs, NUM_RESULTS);
+    else top = scoreAllDocs(q, set, idfs, indexes->pageranks, weights, NUM_RESULTS);
+
+    for (int i = 0; i < top->numDocs; i++) {
+        if (printScores) fprintf(out, "%s %lf\n", top->docs[i].url, top->docs[i].score);
+        else fprintf(out, "%s\n", top->docs[i].url);
+    }
+
+    freeTopDocs(top);
+    free(idfs);
+    freeQuery(q, set);
+    return NULL;
+}
+
+// Finds the size best documents for a query in one pass over the postings
+// of its terms, adding up each document's terms found and tf-idf, then
+// adding its pagerank. The tf-idf is only worked out if it is weighted
+topDocs scoreAllDocs(query q, segmentSet set, double *idfs, pagerankIndex pageranks,
+    struct rankWeights *weights, int size) {
+    accumulators acc = newAccumulators(set->numIds);
+
+    for (int t = 0; t < q->numTerms; t++) {
+        for (int s = 0; s < set->numSegments; s++) {
+            segment seg = set->segments[s];
+            int term = findTerm(seg->index, q->terms[t]);
+            int length;
+            int *docs = getTermDocs(q, set, t, s, &length);
+
+            for (int i = 0; i < length; i++) {
+                double tf = 0;
+                if (weights->tfIdf != 0) {
+                    if (q->phrases[t] != NULL) tf = calculatePhraseTf(seg->forward, docs[i], q->phrases[t][s]);
+                    else tf = calculateTf(seg->forward, docs[i], term);
+                }
+
+                addScore(acc, set->firstIds[s] + docs[i], tf * idfs[t]);
+            }
+        }
+    }
+
+    topDocs top = newTopDocs(size);
+    for (int i = 0; i < acc->numTouched; i++) {
+        int id = acc->touched[i];
+        struct rankedDoc doc;
+        doc.key = weights->count * acc->counts[id] + weights->tfIdf * acc->scores[id];
+        if (weights->pagerank != 0) doc.key += weights->pagerank * pageranks->ranks[id];
+        doc.score = acc->scores[id];
+        doc.id = id;
+        doc.url = getMatchUrl(set, id);
+        offerTopDoc(top, doc);
+    }
+    sortTopDocs(top);
+
+    freeAccumulators(acc);
+    return top;
+}
+
+// Returns the preset ranking of a search program, or NULL if there is no
+// such program
+static struct rankPreset *findPreset(char *program) {
+    for (int i = 0; i < NUM_PRESETS; i++) {
+        if (strcmp(presets[i].program, program) == 0) return &presets[i];
+    }
+    return NULL;
+}
+
+// Returns a hash of the URL of every document in ID order, which changes
+// whenever documents are renumbered
+static unsigned int hashDocUrls(segmentSet set) {
+    unsigned int hash = 2166136261u;
+    for (int s = 0; s < set->numSegments; s++) {
+        invertedIndex index = set->segments[s]->index;
+        for (unsigned int d = 0; d < index->header->numDocs; d++) {
+            hash = (hash ^ hashTerm(getDocUrl(index, d))) * 16777619u;
+        }
+    }
+    return hash;
+}
+
+// Returns the reason the indexes could not be loaded, having freed those
+// that were, or NULL if every index asked for was loaded
+static char *checkRankIndexes(struct rankIndexes *indexes, int impact) {
+    if (indexes->set != NULL && (!impact || indexes->impacts != NULL)) return NULL;
+
+    freeRankIndexes(indexes);
+    indexes->set = NULL;
+    indexes->pageranks = NULL;
+    indexes->impacts = NULL;
+    return getIndexError();
+}
@@ -0,0 +1,70 @@
+#ifndef RANK_H
+#define RANK_H
+
+#include <stdio.h>
+
+#include "search.h"
+#include "topk.h"
+
+#define PAGERANK_LIST "pagerankList.txt"
+#define PAGERANK_INDEX "pagerankIndex.bin"
+#define PAGERANK_MAGIC 0x4B4E5250
+#define PAGERANK_VERSION 1
+
+// Printed precision of a pagerank, which both pagerank files hold
+#define PAGERANK_FORMAT "%.7f"
+
+// Names of the programs a search can be ranked as
+#define RANK_PAGERANK "searchPagerank"
+#define RANK_TFIDF "searchTfIdf"
+
+// Binary pagerank layout: the header, then the pagerank of every document
+// as a double, indexed by document ID across every segment. urlHash
+// fingerprints the URLs of the documents in ID order, so that ranks written
+// before the IDs changed are never used
+struct pagerankHeader {
+    unsigned int magic;
+    unsigned int version;
+    unsigned int numIds;
+    unsigned int urlHash;
+};
+
+typedef struct _pagerankIndex *pagerankIndex;
+
+// The pagerank of each document by ID, mapped from the binary file, or read
+// from the list if map is NULL
+struct _pagerankIndex {
+    void *map;
+    size_t size;
+    double *ranks;
+};
+
+// Every index a search may be ranked from, loaded once for many searches.
+// pageranks and impacts are NULL if their files did not exist
+struct rankIndexes {
+    segmentSet set;
+    pagerankIndex pageranks;
+    impactIndex impacts;
+};
+
+char *loadRankIndexes(struct rankIndexes *indexes);
+char *loadSearchIndexes(struct rankIndexes *indexes, char *program, struct searchOptions *options,
+    stringList searchTerms);
+void freeRankIndexes(struct rankIndexes *indexes);
+
+pagerankIndex openPagerankIndex(segmentSet set);
+void closePagerankIndex(pagerankIndex pageranks);
+double *readPageranks(segmentSet set, char *pagerankList);
+void writePagerankIndex(char **urls, double *ranks, int numUrls, char *output);
+
+char *searchKey(char *program, struct searchOptions *options, stringList searchTerms);
+char *rankSearch(char *program, struct rankIndexes *indexes, struct searchOptions *options,
+    stringList searchTerms, FILE *out);
+
+struct rankWeights *getRankWeights(char *program, struct searchOptions *options);
+char *rankHybrid(struct rankIndexes *indexes, struct rankWeights *weights,
+    struct searchOptions *options, stringList searchTerms, int printScores, FILE *out);
+topDocs scoreAllDocs(query q, segmentSet set, double *idfs, pagerankIndex pageranks,
+    struct rankWeights *weights, int size);
+
+#endif
@@ -1,14 +1,112 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
 
 #include "search.h"
 
+static idVector **matchRequired(segmentSet set, char **terms, int numWords, int numTerms,
+    phraseMatches **phrases, int required);
+static int compareTermNames(const void *a, const void *b);
+static void searchUsage(char *program, char *option);
+
+// Reads the options given before the search terms, and returns the position
+// of the first search term. -and requires every term to match, -min N
+// requires at least N of them, -impact ranks from the impact index,
+// -weights C,T,P ranks by C per term found plus T times the tf-idf plus P
+// times the pagerank, and -batch FILE runs the searches in a file on
+// -threads N threads. Options end at the first argument that is not one of
+// these, or after "--", so search terms may start with '-'
+int parseSearchOptions(int argc, char *argv[], struct searchOptions *options) {
+    int arg = 1;
+    options->minMatch = MATCH_ANY;
+    options->impact = 0;
+    options->weighted = 0;
+    options->batch = NULL;
+    options->numThreads = 0;
+
+    while (arg < argc) {
+        char *option = argv[arg];
+        char *value = arg + 1 < argc ? argv[arg + 1] : NULL;
+
+        if (strcmp(option, "--") == 0) {
+            arg++;
+            break;
+        } else if (strcmp(option, "-and") == 0) {
+            options->minMatch = MATCH_ALL;
+            arg++;
+        } else if (strcmp(option, "-impact") == 0) {
+            options->impact = 1;
+            arg++;
+        } else if (strcmp(option, "-min") == 0) {
+            if (value == NULL || atoi(value) <= 0) searchUsage(argv[0], option);
+            options->minMatch = atoi(value);
+            arg += 2;
+        } else if (strcmp(option, "-weights") == 0) {
+            if (value == NULL || !parseWeights(value, &options->weights)) searchUsage(argv[0], option);
+            options->weighted = 1;
+            arg += 2;
+        } else if (strcmp(option, "-batch") == 0) {
+            if (value == NULL) searchUsage(argv[0], option);
+            options->batch = value;
+            arg += 2;
+        } else if (strcmp(option, "-threads") == 0) {
+            if (value == NULL || atoi(value) <= 0) searchUsage(argv[0], option);
+            options->numThreads = atoi(value);
+            arg += 2;
+        } else {
+            break;
+        }
+    }
+
+    if (options->batch != NULL && arg < argc) {
+        printf("ERROR: Search terms cannot be given with -batch\n");
+        exit(1);
+    }
+
+    return arg;
+}
+
+// Reports an option given without a valid value, prints the usage of a
+// search program and exits
+static void searchUsage(char *program, char *option) {
+    printf("ERROR: Invalid value for option '%s'\n", option);
+    printf("%s [-and | -min N] [-impact] [-weights C,T,P] [--] term...\n", program);
+    printf("%s [-and | -min N] [-impact] [-weights C,T,P] -batch FILE [-threads N]\n", program);
+    exit(1);
+}
+
+// Reads weights given as three numbers separated by commas: for each term
+// found, for the tf-idf and for the pagerank. Returns whether they are valid
+int parseWeights(char *text, struct rankWeights *weights) {
+    char extra;
+    if (sscanf(text, "%lf,%lf,%lf%c", &weights->count, &weights->tfIdf, &weights->pagerank,
+        &extra) != 3) return 0;
+    return isfinite(weights->count) && isfinite(weights->tfIdf) && isfinite(weights->pagerank);
+}
+
 // Returns a string list containing the search terms given in the arguments
-stringList parseSearchTerms(int argc, char *argv[]) {
+// from position first. An argument of several words, such as
+// "quick brown fox", is a phrase, and a word ending in '*', such as
+// "astro*", is a prefix
+stringList parseSearchTerms(int argc, char *argv[], int first) {
     stringList searchTerms = newStringList();
 
-    for (int i = 1; i < argc; i++) {
-        char *cleaned = cleanString(argv[i]);
+    for (int i = first; i < argc; i++) {
+        char *cleaned;
+        if (strchr(argv[i], ' ') != NULL) {
+            cleaned = cleanPhrase(argv[i]);
+        } else {
+            cleaned = cleanString(argv[i]);
+
+            // Keep the wildcard ending a prefix, unless nothing is before it
+            int length = strlen(argv[i]);
+            if (length > 0 && argv[i][length - 1] == PREFIX_WILDCARD && cleaned[0] != '\0') {
+                cleaned = realloc(cleaned, strlen(cleaned) + 2);
+                strcat(cleaned, "*");
+            }
+        }
         appendToStringList(searchTerms, cleaned);
         free(cleaned);
     }
@@ -16,42 +114,423 @@ stringList parseSearchTerms(int argc, char *argv[]) {
     return searchTerms;
 }
 
-// Using an inverted index file, returns the URLs that contain
-// one or more search terms
-stringList getMatchingUrls(stringList searchTerms, char* invertedIndex) { 
-    FILE* index = fopen(invertedIndex, "r");
+// Splits a line of search terms at spaces, in place, keeping the words of
+// a phrase in double quotes together, and returns the number of terms.
+// The terms last as long as the line
+int splitSearchLine(char *line, char ***terms) {
+    int numTerms = 0;
+    *terms = calloc(strlen(line) / 2 + 1, sizeof(char *));
 
-    if (index == NULL) {
-        printf("ERROR: Could not open inverted index file '%s'\n", invertedIndex);
-        exit(1);
+    char *c = line;
+    while (1) {
+        while (isspace((unsigned char)*c)) c++;
+        if (*c == '\0') break;
+
+        // A quoted phrase ends at the closing quote, and a word at a space
+        int quoted = *c == '"';
+        if (quoted) c++;
+        (*terms)[numTerms] = c;
+        numTerms++;
+
+        while (*c != '\0' && (quoted ? *c != '"' : !isspace((unsigned char)*c))) c++;
+        if (*c == '\0') break;
+        *c = '\0';
+        c++;
+    }
+
+    return numTerms;
+}
+
+// Returns whether any search term is a phrase, which needs positional indexes
+int hasPhrase(stringList searchTerms) {
+    for (stringNode n = searchTerms->start; n != NULL; n = n->next) {
+        if (isPhrase(n->string)) return 1;
+    }
+    return 0;
+}
+
+// Returns whether a search term is a prefix, matching every word it starts
+int isPrefix(char *term) {
+    int length = strlen(term);
+    return length > 1 && term[length - 1] == PREFIX_WILDCARD && strchr(term, ' ') == NULL;
+}
+
+// Fills terms with the distinct search terms in the order a query holds
+// them: words in dictionary order, then phrases and prefixes as given.
+// Returns the number of terms and sets numWords to how many are words.
+// Searches normalising to the same terms always rank the same
+int normaliseTerms(stringList searchTerms, char **terms, int *numWords) {
+    int numTerms = 0;
+
+    for (int phrases = 0; phrases <= 1; phrases++) {
+        for (stringNode n = searchTerms->start; n != NULL; n = n->next) {
+            // Words with no letters or digits were never searchable
+            int multiple = isPhrase(n->string) || isPrefix(n->string);
+            if (n->string[0] == '\0' || multiple != phrases) continue;
+
+            int found = 0;
+            for (int i = 0; i < numTerms; i++) {
+                if (strcmp(terms[i], n->string) == 0) found = 1;
+            }
+
+            if (!found) {
+                terms[numTerms] = n->string;
+                numTerms++;
+            }
+        }
+
+        if (!phrases) {
+            *numWords = numTerms;
+            qsort(terms, *numWords, sizeof(char *), compareTermNames);
+        }
+    }
+
+    return numTerms;
+}
+
+// Looks up the search terms in an open set of segments. Each word is looked
+// up once, in dictionary order, and then each phrase or prefix once, in the
+// order given. Unless any one term will do, the documents containing at least
+// minMatch terms, or every term for MATCH_ALL, are found up front
+query newQuery(stringList searchTerms, segmentSet set, int minMatch) {
+    query q = malloc(sizeof(struct _query));
+    q->terms = calloc(stringListLength(searchTerms), sizeof(char *));
+    q->numTerms = normaliseTerms(searchTerms, q->terms, &q->numWords);
+
+    q->phrases = calloc(q->numTerms, sizeof(phraseMatches *));
+    for (int t = q->numWords; t < q->numTerms; t++) {
+        if (isPrefix(q->terms[t])) q->phrases[t] = matchSegmentPrefix(set, q->terms[t]);
+        else q->phrases[t] = matchSegmentPhrase(set, q->terms[t]);
+    }
+
+    int required = minMatch == MATCH_ALL ? q->numTerms : minMatch;
+    q->found = NULL;
+    if (required > 1) {
+        q->found = matchRequired(set, q->terms, q->numWords, q->numTerms, q->phrases, required);
+    }
+
+    unsigned int maxDocs = 0;
+    for (int s = 0; s < set->numSegments; s++) {
+        unsigned int numDocs = set->segments[s]->index->header->numDocs;
+        if (numDocs > maxDocs) maxDocs = numDocs;
+    }
+    q->buffer = calloc(maxDocs, sizeof(int));
+
+    return q;
+}
+
+// Returns the live documents of a segment matched by one query term, in ID
+// order, and sets length to their number. The IDs last until the next call
+int *getTermDocs(query q, segmentSet set, int term, int s, int *length) {
+    segment seg = set->segments[s];
+
+    if (q->found != NULL) {
+        *length = q->found[term][s]->length;
+        return q->found[term][s]->ids;
+    }
+
+    if (term >= q->numWords) {
+        *length = q->phrases[term][s]->numDocs;
+        return q->phrases[term][s]->docs;
+    }
+
+    int t = findTerm(seg->index, q->terms[term]);
+    int numDocs = t == NO_TERM ? 0 : readTermPostings(seg->index, t, q->buffer);
+
+    *length = 0;
+    for (int i = 0; i < numDocs; i++) {
+        if (!isLiveDoc(seg, q->buffer[i])) continue;
+        q->buffer[*length] = q->buffer[i];
+        (*length)++;
+    }
+
+    return q->buffer;
+}
+
+// Counts the query terms found in each document, one term at a time, with
+// documents numbered across every segment
+void matchQuery(query q, segmentSet set, accumulators acc) {
+    for (int t = 0; t < q->numTerms; t++) {
+        for (int s = 0; s < set->numSegments; s++) {
+            int length;
+            int *docs = getTermDocs(q, set, t, s, &length);
+            for (int i = 0; i < length; i++) addScore(acc, set->firstIds[s] + docs[i], 0);
+        }
+    }
+}
+
+// Orders the documents found by a query from best to worst. Documents are
+// ranked by the number of terms found plus their score, and equal ranks are
+// in URL order
+void sortMatches(accumulators acc, segmentSet set) {
+    struct rankedDoc *ranked = calloc(acc->numTouched, sizeof(struct rankedDoc));
+
+    for (int i = 0; i < acc->numTouched; i++) {
+        int id = acc->touched[i];
+        int doc;
+        int s = getIdSegment(set, id, &doc);
+
+        ranked[i].key = acc->counts[id] + acc->scores[id];
+        ranked[i].score = acc->scores[id];
+        ranked[i].id = id;
+        ranked[i].url = getDocUrl(set->segments[s]->index, doc);
+    }
+
+    qsort(ranked, acc->numTouched, sizeof(struct rankedDoc), compareRankedDocs);
+    for (int i = 0; i < acc->numTouched; i++) acc->touched[i] = ranked[i].id;
+    free(ranked);
+}
+
+// Orders ranked documents from best to worst. Documents with equal keys are
+// ordered by URL, so every ranker gives ties in the same order whatever
+// order it found them in
+int compareRankedDocs(const void *a, const void *b) {
+    struct rankedDoc *x = (struct rankedDoc *)a;
+    struct rankedDoc *y = (struct rankedDoc *)b;
+
+    if (x->key != y->key) return x->key < y->key ? 1 : -1;
+    return compareCollated(x->url, y->url);
+}
+
+// Returns the URL of a document numbered across every segment
+char *getMatchUrl(segmentSet set, int id) {
+    int doc;
+    int s = getIdSegment(set, id, &doc);
+    return getDocUrl(set->segments[s]->index, doc);
+}
+
+// Frees the memory occupied by a query
+void freeQuery(query q, segmentSet set) {
+    for (int t = 0; t < q->numTerms; t++) {
+        if (q->phrases[t] != NULL) freeSegmentPhrase(set, q->phrases[t]);
+        for (int s = 0; q->found != NULL && s < set->numSegments; s++) {
+            freeIdVector(q->found[t][s]);
+        }
+        if (q->found != NULL) free(q->found[t]);
+    }
+
+    free(q->terms);
+    free(q->phrases);
+    free(q->found);
+    free(q->buffer);
+    free(q);
+}
+
+// Matches a phrase in every segment, leaving out dead documents, and returns
+// the matches of each segment in turn
+phraseMatches *matchSegmentPhrase(segmentSet set, char *term) {
+    phraseMatches *matches = calloc(set->numSegments, sizeof(phraseMatches));
+
+    for (int s = 0; s < set->numSegments; s++) {
+        segment seg = set->segments[s];
+
+        if (seg->positions == NULL) {
+            printf("%s\n", PHRASE_INDEX_ERROR);
+            exit(1);
+        }
+
+        matches[s] = matchPhrase(seg->index, seg->positions, term);
+
+        int numLive = 0;
+        for (int i = 0; i < matches[s]->numDocs; i++) {
+            if (isLiveDoc(seg, matches[s]->docs[i])) {
+                matches[s]->docs[numLive] = matches[s]->docs[i];
+                matches[s]->counts[numLive] = matches[s]->counts[i];
+                numLive++;
+            }
+        }
+        matches[s]->numDocs = numLive;
+    }
+
+    return matches;
+}
+
+// Matches every word starting with a prefix in every segment, leaving out
+// dead documents, as though they were one word. The words are numbered
+// consecutively, so each segment's are found together, and a document's
+// count is the total of theirs
+phraseMatches *matchSegmentPrefix(segmentSet set, char *term) {
+    phraseMatches *matches = calloc(set->numSegments, sizeof(phraseMatches));
+    char *prefix = malloc(strlen(term) + 1);
+    strcpy(prefix, term);
+    prefix[strlen(prefix) - 1] = '\0';
+
+    for (int s = 0; s < set->numSegments; s++) {
+        segment seg = set->segments[s];
+        int numDocs = seg->index->header->numDocs;
+        int *counts = calloc(numDocs + 1, sizeof(int));
+        int *ids = malloc((numDocs + 1) * sizeof(int));
+
+        int numTerms;
+        int first = findPrefixTerms(seg->index, prefix, &numTerms);
+        for (int t = first; t < first + numTerms; t++) {
+            int length = readTermPostings(seg->index, t, ids);
+            for (int i = 0; i < length; i++) counts[ids[i]] += getTermCount(seg->forward, ids[i], t);
+        }
+
+        matches[s] = malloc(sizeof(struct _phraseMatches));
+        matches[s]->numDocs = 0;
+        matches[s]->docs = ids;
+        matches[s]->counts = malloc((numDocs + 1) * sizeof(int));
+
+        for (int doc = 0; doc < numDocs; doc++) {
+            if (counts[doc] == 0 || !isLiveDoc(seg, doc)) continue;
+            matches[s]->docs[matches[s]->numDocs] = doc;
+            matches[s]->counts[matches[s]->numDocs] = counts[doc];
+            matches[s]->numDocs++;
+        }
+        free(counts);
+    }
+
+    free(prefix);
+    return matches;
+}
+
+// Returns the number of live documents containing a phrase
+long countPhraseDocs(segmentSet set, phraseMatches *matches) {
+    long numDocs = 0;
+    for (int s = 0; s < set->numSegments; s++) numDocs += matches[s]->numDocs;
+    return numDocs;
+}
+
+// Frees the phrase matches of every segment
+void freeSegmentPhrase(segmentSet set, phraseMatches *matches) {
+    for (int s = 0; s < set->numSegments; s++) freePhraseMatches(matches[s]);
+    free(matches);
+}
+
+// Looks up the term frequency of a term within a document
+double calculateTf(forwardIndex forward, int doc, int term) {
+    double count = getTermCount(forward, doc, term);
+    double total = getDocLength(forward, doc);
+
+    return count / total;
+}
+
+// Calculates the inverse document frequency for a term, from the number of
+// live documents and how many of them contain the term
+double calculateIdf(segmentSet set, char *term) {
+    long docFreq = term[0] == '\0' ? 0 : getLiveDocFreq(set, term);
+    if (docFreq == 0) return 0;
+
+    double numAll = set->numDocs;
+    double numMatches = docFreq;
+
+    return log(numAll / numMatches);    
+}
+
+// Calculates the term frequency of a phrase within a document, from the
+// number of times the phrase starts there
+double calculatePhraseTf(forwardIndex forward, int doc, phraseMatches matches) {
+    double count = getPhraseCount(matches, doc);
+    double total = getDocLength(forward, doc);
+
+    return count / total;
+}
+
+// Calculates the inverse document frequency for a phrase, from the number
+// of live documents containing the whole phrase
+double calculatePhraseIdf(segmentSet set, phraseMatches *matches) {
+    long docFreq = countPhraseDocs(set, matches);
+    if (docFreq == 0) return 0;
+
+    double numAll = set->numDocs;
+    double numMatches = docFreq;
+
+    return log(numAll / numMatches);
+}
+
+// Finds the live documents containing at least required query terms, and
+// returns the ones found for each term in each segment. A document missing
+// at most numTerms - required terms must be in at least one of the
+// numTerms - required + 1 shortest lists, so only those are stepped
+// through. The rest are skipped ahead to each candidate, shortest first,
+// and given up on as soon as the candidate cannot reach the required count
+static idVector **matchRequired(segmentSet set, char **terms, int numWords, int numTerms,
+    phraseMatches **phrases, int required) {
+    idVector **found = calloc(numTerms, sizeof(idVector *));
+    for (int q = 0; q < numTerms; q++) {
+        found[q] = calloc(set->numSegments, sizeof(idVector));
+        for (int s = 0; s < set->numSegments; s++) found[q][s] = newIdVector();
     }
 
-    char buffer[1024];
-    stringList urls = newStringList();
+    if (required > numTerms) return found;
 
-    while (fgets(buffer, MAX_LINE, index)) {
-        stringList line = readWords(buffer);
+    struct postingCursor *cursors = calloc(numTerms, sizeof(struct postingCursor));
+    unsigned char **encoded = calloc(numTerms, sizeof(unsigned char *));
+    int *order = calloc(numTerms, sizeof(int));
+    int *hits = calloc(numTerms, sizeof(int));
+    int numLead = numTerms - required + 1;
 
-        // Check that line contains a term, and that it's one of the search terms
-        if (line->start != NULL && inStringList(searchTerms, line->start->string)) {
-            // Add all URLs on same line to list of URLs
-            for (stringNode n = line->start->next; n != NULL; n = n->next) {
-                if (!inStringList(urls, n->string)) {
-                    appendToStringList(urls, n->string);
-                }    
+    for (int s = 0; s < set->numSegments; s++) {
+        segment seg = set->segments[s];
 
-                // Increase URL key when term found
-                stringNode current = getNode(urls, n->string);
-                appendToStringList(current->list, line->start->string);
-                if (current->key == NO_KEY) current->key = 1;
-                else current->key++;
+        // Phrase matches are encoded like postings so every list is stepped
+        // through the same way
+        for (int q = 0; q < numTerms; q++) {
+            if (q >= numWords) {
+                phraseMatches matches = phrases[q][s];
+                encoded[q] = realloc(encoded[q], skipPostingsBound(matches->numDocs));
+                encodeSkipPostings(matches->docs, matches->numDocs, encoded[q]);
+                openCursor(&cursors[q], encoded[q], matches->numDocs);
+            } else {
+                int t = findTerm(seg->index, terms[q]);
+                if (t == NO_TERM) openCursor(&cursors[q], NULL, 0);
+                else openTermCursor(seg->index, t, &cursors[q]);
             }
+            order[q] = q;
         }
 
-        freeStringList(line);
+        // Order the lists from shortest to longest
+        for (int i = 1; i < numTerms; i++) {
+            for (int j = i; j > 0 && cursors[order[j]].length < cursors[order[j - 1]].length; j--) {
+                int swap = order[j];
+                order[j] = order[j - 1];
+                order[j - 1] = swap;
+            }
+        }
+
+        for (int k = 0; k < numLead; k++) nextPosting(&cursors[order[k]]);
+
+        while (1) {
+            int doc = END_POSTING;
+            for (int k = 0; k < numLead; k++) {
+                if (cursors[order[k]].doc < doc) doc = cursors[order[k]].doc;
+            }
+            if (doc == END_POSTING) break;
+
+            int count = 0;
+            for (int k = 0; k < numLead; k++) {
+                hits[order[k]] = cursors[order[k]].doc == doc;
+                count += hits[order[k]];
+            }
+
+            for (int k = numLead; k < numTerms; k++) hits[order[k]] = 0;
+            for (int k = numLead; k < numTerms && count + numTerms - k >= required; k++) {
+                hits[order[k]] = seekPosting(&cursors[order[k]], doc) == doc;
+                count += hits[order[k]];
+            }
+
+            if (count >= required && isLiveDoc(seg, doc)) {
+                for (int q = 0; q < numTerms; q++) {
+                    if (hits[q]) appendIdVector(found[q][s], doc);
+                }
+            }
+
+            for (int k = 0; k < numLead; k++) {
+                if (cursors[order[k]].doc == doc) nextPosting(&cursors[order[k]]);
+            }
+        }
     }
 
-    fclose(index);
+    for (int q = 0; q < numTerms; q++) free(encoded[q]);
+    free(cursors);
+    free(encoded);
+    free(order);
+    free(hits);
+    return found;
+}
 
-    return urls;
-}
\ No newline at end of file
+static int compareTermNames(const void *a, const void *b) {
+    return compareCollated(*(char **)a, *(char **)b);
+}
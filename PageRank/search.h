@@ -2,8 +2,86 @@
 #define SEARCH_H
 
 #include "text.h"
+#include "index.h"
+#include "phrase.h"
+#include "segments.h"
+#include "accumulator.h"
 
-stringList parseSearchTerms(int argc, char *argv[]);
-stringList getMatchingUrls(stringList searchTerms, char* invertedIndex);
+// Number of search terms a URL must contain by default, and the value
+// meaning that it must contain every one
+#define MATCH_ANY 1
+#define MATCH_ALL 0
 
-#endif
\ No newline at end of file
+#define PHRASE_INDEX_ERROR "ERROR: Phrase queries need a positional index, built with 'inverted -p'"
+
+// Character ending a search term that matches every word it starts
+#define PREFIX_WILDCARD '*'
+
+typedef struct _query *query;
+
+// Search terms looked up in a set of segments: distinct words in dictionary
+// order, followed by distinct phrases and prefixes
+struct _query {
+    int numTerms;
+    int numWords;
+    char **terms;
+    phraseMatches **phrases;    // Matches of each phrase or prefix in each segment,
+                                // NULL for words
+    idVector **found;           // Documents of each term in each segment that
+                                // contain enough terms, NULL if any term will do
+    int *buffer;
+};
+
+// How much each thing known about a matching document adds to its rank
+struct rankWeights {
+    double count;       // For each search term found
+    double tfIdf;       // For the sum of each term's tf-idf
+    double pagerank;
+};
+
+// Options given before the search terms
+struct searchOptions {
+    int minMatch;   // Number of terms a URL must contain, or MATCH_ALL
+    int impact;     // Whether to rank from the impact index
+    int weighted;   // Whether weights replace the program's own ranking
+    struct rankWeights weights;
+    char *batch;    // File of searches to run, one per line, "-" for standard
+                    // input, or NULL to run the search given
+    int numThreads; // Threads running a batch, 0 for one per core
+};
+
+// A matched document with the key it is ranked by
+struct rankedDoc {
+    double key;
+    double score;
+    int id;
+    char *url;
+};
+
+int parseSearchOptions(int argc, char *argv[], struct searchOptions *options);
+int parseWeights(char *text, struct rankWeights *weights);
+stringList parseSearchTerms(int argc, char *argv[], int first);
+int hasPhrase(stringList searchTerms);
+int isPrefix(char *term);
+int splitSearchLine(char *line, char ***terms);
+
+int normaliseTerms(stringList searchTerms, char **terms, int *numWords);
+query newQuery(stringList searchTerms, segmentSet set, int minMatch);
+int *getTermDocs(query q, segmentSet set, int term, int s, int *length);
+void matchQuery(query q, segmentSet set, accumulators acc);
+void sortMatches(accumulators acc, segmentSet set);
+int compareRankedDocs(const void *a, const void *b);
+char *getMatchUrl(segmentSet set, int id);
+void freeQuery(query q, segmentSet set);
+
+phraseMatches *matchSegmentPhrase(segmentSet set, char *term);
+phraseMatches *matchSegmentPrefix(segmentSet set, char *term);
+long countPhraseDocs(segmentSet set, phraseMatches *matches);
+void freeSegmentPhrase(segmentSet set, phraseMatches *matches);
+
+double calculateTf(forwardIndex forward, int doc, int term);
+double calculateIdf(segmentSet set, char *term);
+double calculatePhraseTf(forwardIndex forward, int doc, phraseMatches matches);
+double calculatePhraseIdf(segmentSet set, phraseMatches *matches);
+
+#endif
@@ -3,68 +3,44 @@
 
 #include "text.h"
 #include "search.h"
-
-#define MAX_LINE 1024
-
-void addPagerank(stringList urls, char *pagerankList);
+#include "rank.h"
+#include "server.h"
+#include "batch.h"
 
 int main(int argc, char* argv[]) {
+    struct searchOptions options;
+    int first = parseSearchOptions(argc, argv, &options);
 
-    if (argc == 1) {
+    if (options.batch != NULL) {
+        searchBatch(RANK_PAGERANK, &options);
+        return 0;
+    }
+
+    if (first == argc) {
         printf("ERROR: No search terms given\n");
         exit(1);
     }
-    
-    // Find all URLs that match search terms
-    stringList searchTerms = parseSearchTerms(argc, argv);
-    stringList urls = getMatchingUrls(searchTerms, "invertedIndex.txt");
 
-    // Add corresponding pagerank to each URL key
-    addPagerank(urls, "pagerankList.txt");
-    stringList sorted = sortStringList(urls);
+    // A running search server already has every index loaded
+    if (sendSearch(RANK_PAGERANK, &options, argc - first, argv + first)) return 0;
 
-    // Print out matching URLs, sorted by number of terms found and pagerank
-    int numOutput = 0;
-    for (stringNode n = sorted->start; n != NULL; n = n->next) {
-        printf("%s\n", n->string);
-        numOutput++;
-        if (numOutput == 30) break;
+    stringList searchTerms = parseSearchTerms(argc, argv, first);
+    struct rankIndexes indexes;
+    char *error = loadSearchIndexes(&indexes, RANK_PAGERANK, &options, searchTerms);
+    if (error != NULL) {
+        printf("%s\n", error);
+        exit(1);
     }
 
-    freeStringList(searchTerms);
-    freeStringList(urls);
-    freeStringList(sorted);
-
-    return 0;
-}
-
-void addPagerank(stringList urls, char *pagerankList) {
-    char buffer[1024];
-    FILE* rank = fopen(pagerankList, "r");
-
-    if (rank == NULL) {
-        printf("ERROR: Could not open pagerank list '%s'", pagerankList);
+    // Print out matching URLs, sorted by number of terms found and pagerank
+    error = rankSearch(RANK_PAGERANK, &indexes, &options, searchTerms, stdout);
+    if (error != NULL) {
+        printf("%s\n", error);
         exit(1);
     }
 
-    while (fgets(buffer, MAX_LINE, rank)) {
-        // Split line into string list
-        stringList line = splitString(buffer, ", ");
-        
-        if (line->start != NULL) {
-            // First word in string list = url name
-            char *url = line->start->string;
-            stringNode urlNode = getNode(urls, url);
-
-            // Last word in string list = pagerank value
-            if (urlNode != NULL) {
-                double prValue = atof(line->end->string);
-                urlNode->key += prValue;
-            }
-        }
-
-        freeStringList(line);
-    }
+    freeRankIndexes(&indexes);
+    freeStringList(searchTerms);
 
-    fclose(rank);
+    return 0;
 }
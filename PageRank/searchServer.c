@@ -0,0 +1,338 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "text.h"
+#include "search.h"
+#include "segments.h"
+#include "indexer.h"
+#include "rank.h"
+#include "server.h"
+#include "cache.h"
+
+// Number of accepted connections that may wait for a free thread
+#define QUEUE_SIZE 64
+
+// Files whose change means the loaded indexes are out of date
+#define NUM_WATCHED 5
+
+// When and how a file was last changed, all zero if it does not exist
+struct fileStamp {
+    ino_t inode;
+    off_t size;
+    struct timespec modified;
+};
+
+// Everything loaded for answering searches, and the results of recent
+// searches. Searches hold the lock for reading, and reloading holds it for
+// writing
+struct searchState {
+    pthread_rwlock_t lock;
+    pthread_mutex_t reloading;
+    struct rankIndexes indexes;
+    resultCache cache;
+    struct fileStamp stamps[NUM_WATCHED];
+};
+
+// Connections accepted but not yet taken by a thread
+struct connectionQueue {
+    pthread_mutex_t lock;
+    pthread_cond_t notEmpty;
+    pthread_cond_t notFull;
+    int fds[QUEUE_SIZE];
+    int head;
+    int count;
+};
+
+static char *watched[NUM_WATCHED] = {BASE_INDEX, SEGMENT_MANIFEST, PAGERANK_LIST, PAGERANK_INDEX,
+    BASE_IMPACT};
+static struct searchState state;
+static struct connectionQueue queue;
+
+void printUsage();
+void printStats();
+int listenOn(char *path);
+void loadIndexes();
+void stampFiles(struct fileStamp *stamps);
+void reloadIfChanged();
+void *serveConnections(void *arg);
+void serveConnection(int fd);
+void answerRequest(char *line, FILE *out);
+void stopServer(int signalNumber);
+
+int main(int argc, char *argv[]) {
+    int numThreads = defaultThreads();
+    int cacheMegabytes = DEFAULT_CACHE_MB;
+    int arg = 1;
+
+    if (argc == 2 && strcmp(argv[1], "-stats") == 0) printStats();
+
+    if (arg + 1 < argc && strcmp(argv[arg], "-cache") == 0) {
+        cacheMegabytes = atoi(argv[arg + 1]);
+        if (cacheMegabytes < 0 || (cacheMegabytes == 0 && strcmp(argv[arg + 1], "0") != 0)) {
+            printf("ERROR: Invalid cache size '%s'\n", argv[arg + 1]);
+            printUsage();
+        }
+        arg += 2;
+    }
+
+    if (argc > arg + 1) printUsage();
+    if (argc == arg + 1) {
+        numThreads = atoi(argv[arg]);
+        if (numThreads < 1) {
+            printf("ERROR: Invalid number of threads '%s'\n", argv[arg]);
+            printUsage();
+        }
+    }
+
+    state.cache = newResultCache((size_t)cacheMegabytes * 1024 * 1024);
+    pthread_rwlock_init(&state.lock, NULL);
+    pthread_mutex_init(&state.reloading, NULL);
+    loadIndexes();
+
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_cond_init(&queue.notEmpty, NULL);
+    pthread_cond_init(&queue.notFull, NULL);
+    queue.head = 0;
+    queue.count = 0;
+
+    int listener = listenOn(SEARCH_SOCKET);
+    signal(SIGINT, stopServer);
+    signal(SIGTERM, stopServer);
+    signal(SIGPIPE, SIG_IGN);
+
+    pthread_t *threads = calloc(numThreads, sizeof(pthread_t));
+    for (int i = 0; i < numThreads; i++) pthread_create(&threads[i], NULL, serveConnections, NULL);
+
+    printf("Serving searches on '%s' with %d threads\n", SEARCH_SOCKET, numThreads);
+    fflush(stdout);
+
+    // Hand each connection to the next free thread
+    while (1) {
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0) continue;
+
+        pthread_mutex_lock(&queue.lock);
+        while (queue.count == QUEUE_SIZE) pthread_cond_wait(&queue.notFull, &queue.lock);
+        queue.fds[(queue.head + queue.count) % QUEUE_SIZE] = fd;
+        queue.count++;
+        pthread_cond_signal(&queue.notEmpty);
+        pthread_mutex_unlock(&queue.lock);
+    }
+
+    return 0;
+}
+
+// Prints how to run the program, and exits
+void printUsage() {
+    printf("searchServer [-cache megabytes] [numThreads]\n");
+    printf("searchServer -stats\n");
+    exit(1);
+}
+
+// Prints how often the running server has found searches in its cache,
+// and exits
+void printStats() {
+    struct searchOptions options;
+    options.minMatch = MATCH_ANY;
+    options.impact = 0;
+    options.weighted = 0;
+
+    if (!sendSearch(CACHE_STATS, &options, 0, NULL)) {
+        printf("ERROR: No search server is running on '%s'\n", SEARCH_SOCKET);
+        exit(1);
+    }
+    exit(0);
+}
+
+// Creates a Unix domain socket at a path and listens on it. A socket left
+// by a server that has stopped is replaced, but a running server is not
+int listenOn(char *path) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && connect(fd, (struct sockaddr *)&address, sizeof(address)) == 0) {
+        printf("ERROR: A search server is already running on '%s'\n", path);
+        exit(1);
+    }
+    if (fd >= 0) close(fd);
+    unlink(path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(fd, QUEUE_SIZE) != 0) {
+        printf("ERROR: Could not listen on '%s'\n", path);
+        exit(1);
+    }
+
+    return fd;
+}
+
+// Loads every index a search may need, noting the files they came from,
+// or exits if they cannot be loaded. The stamps are taken first, so that a
+// change while loading is seen later
+void loadIndexes() {
+    stampFiles(state.stamps);
+    char *error = loadRankIndexes(&state.indexes);
+    if (error != NULL) {
+        printf("%s\n", error);
+        exit(1);
+    }
+}
+
+// Records when each watched file was last changed
+void stampFiles(struct fileStamp *stamps) {
+    for (int i = 0; i < NUM_WATCHED; i++) {
+        struct stat info;
+        memset(&stamps[i], 0, sizeof(struct fileStamp));
+        if (stat(watched[i], &info) != 0) continue;
+
+        stamps[i].inode = info.st_ino;
+        stamps[i].size = info.st_size;
+        stamps[i].modified = info.st_mtim;
+    }
+}
+
+// Loads the indexes again if a rebuild, update or merge has changed them
+// since they were loaded. Only one thread checks at a time. The new indexes
+// are loaded while searches still use the old ones, which are replaced once
+// the searches in progress finish. If the new indexes cannot be loaded, as
+// while a rebuild is removing files, the old ones are kept and the next
+// request tries again
+void reloadIfChanged() {
+    struct fileStamp stamps[NUM_WATCHED];
+
+    pthread_mutex_lock(&state.reloading);
+    stampFiles(stamps);
+
+    if (memcmp(stamps, state.stamps, sizeof(stamps)) != 0) {
+        struct rankIndexes indexes;
+        char *error = loadRankIndexes(&indexes);
+
+        if (error != NULL) {
+            printf("%s\n", error);
+            fflush(stdout);
+        } else {
+            pthread_rwlock_wrlock(&state.lock);
+            freeRankIndexes(&state.indexes);
+            state.indexes = indexes;
+            memcpy(state.stamps, stamps, sizeof(stamps));
+            clearResultCache(state.cache);
+            pthread_rwlock_unlock(&state.lock);
+        }
+    }
+
+    pthread_mutex_unlock(&state.reloading);
+}
+
+// Takes connections from the queue and answers them, forever
+void *serveConnections(void *arg) {
+    (void)arg;
+    while (1) {
+        pthread_mutex_lock(&queue.lock);
+        while (queue.count == 0) pthread_cond_wait(&queue.notEmpty, &queue.lock);
+        int fd = queue.fds[queue.head];
+        queue.head = (queue.head + 1) % QUEUE_SIZE;
+        queue.count--;
+        pthread_cond_signal(&queue.notFull);
+        pthread_mutex_unlock(&queue.lock);
+
+        serveConnection(fd);
+    }
+
+    return NULL;
+}
+
+// Answers each request sent on a connection until the client closes it
+void serveConnection(int fd) {
+    FILE *in = fdopen(fd, "r");
+    FILE *out = fdopen(dup(fd), "w");
+    char *line = NULL;
+    size_t size = 0;
+
+    while (getline(&line, &size, in) > 0) {
+        reloadIfChanged();
+
+        pthread_rwlock_rdlock(&state.lock);
+        answerRequest(line, out);
+        pthread_rwlock_unlock(&state.lock);
+
+        // An empty line ends every reply
+        fputc('\n', out);
+        if (fflush(out) != 0) break;
+    }
+
+    free(line);
+    fclose(in);
+    fclose(out);
+}
+
+// Runs the search in one request line, and writes the results. Results
+// are taken from the cache if the same search has been run, and cached if
+// not
+void answerRequest(char *line, FILE *out) {
+    char **fields;
+    int numFields = splitRequest(line, &fields);
+
+    if (strcmp(fields[0], CACHE_STATS) == 0) {
+        printCacheStats(state.cache, out);
+        free(fields);
+        return;
+    }
+
+    if (numFields <= REQUEST_FIELDS) {
+        fprintf(out, "ERROR: Malformed search request\n");
+        free(fields);
+        return;
+    }
+
+    struct searchOptions options;
+    options.minMatch = atoi(fields[1]);
+    options.impact = atoi(fields[2]);
+    options.weighted = fields[3][0] != '\0';
+    if (options.weighted && !parseWeights(fields[3], &options.weights)) {
+        fprintf(out, "ERROR: Malformed search request\n");
+        free(fields);
+        return;
+    }
+    options.batch = NULL;
+    options.numThreads = 0;
+
+    // The fields before the terms stand in for the program's options
+    stringList searchTerms = parseSearchTerms(numFields, fields, REQUEST_FIELDS);
+    char *key = searchKey(fields[0], &options, searchTerms);
+    size_t size;
+    char *results = findCachedResult(state.cache, key, &size);
+
+    // Errors are cheap to find again, so only results are cached
+    if (results == NULL) {
+        FILE *buffer = open_memstream(&results, &size);
+        char *error = rankSearch(fields[0], &state.indexes, &options, searchTerms, buffer);
+        fclose(buffer);
+
+        if (error != NULL) fprintf(out, "%s\n", error);
+        else cacheResult(state.cache, key, results, size);
+    }
+    fwrite(results, 1, size, out);
+
+    free(results);
+    free(key);
+    freeStringList(searchTerms);
+    free(fields);
+}
+
+// Removes the socket and exits when the server is stopped
+void stopServer(int signalNumber) {
+    (void)signalNumber;
+    unlink(SEARCH_SOCKET);
+    _exit(0);
+}
@@ -1,113 +1,48 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include <string.h>
-#include <math.h>
 
 #include "text.h"
 #include "search.h"
-
-double getTfIdfSum(stringNode url);
-double calculateTf(char *string, char *term);
-double calculateIdf(char *collection, char *invertedIndex, char *term);
+#include "rank.h"
+#include "server.h"
+#include "batch.h"
 
 int main(int argc, char *argv[]) {
-    if (argc == 1) {
+    struct searchOptions options;
+    int first = parseSearchOptions(argc, argv, &options);
+
+    if (options.batch != NULL) {
+        searchBatch(RANK_TFIDF, &options);
+        return 0;
+    }
+
+    if (first == argc) {
         printf("ERROR: No search terms given\n");
         exit(1);
     }
 
-    stringList searchTerms = parseSearchTerms(argc, argv);
-    stringList urls = getMatchingUrls(searchTerms, "invertedIndex.txt");
-
-    // Calculate idf for every term given
-    for (stringNode n = searchTerms->start; n != NULL; n = n->next) {
-        n->key = calculateIdf("collection.txt", "invertedIndex.txt", n->string);
-    }  
-
-    // Calculate sum of tf-idf for each URL
-    for (stringNode n = urls->start; n != NULL; n = n->next) {
-        char *url = n->string;
-        char *filename = stringJoin(url, ".txt");
-        char *sectionText = readSection(filename, "Section-2");
-
-        // Calculate tf-idf for every term found at the URL
-        for (stringNode term = n->list->start; term != NULL; term = term->next) {
-            double tf = calculateTf(sectionText, term->string);
-            double idf;
-
-            stringNode idfNode = getNode(searchTerms, term->string);
+    // A running search server already has every index loaded
+    if (sendSearch(RANK_TFIDF, &options, argc - first, argv + first)) return 0;
 
-            if (idfNode != NULL) idf = idfNode->key;
-            else idf = 0;
-
-            term->key = tf * idf;
-            n->key += tf * idf;
-        }
-
-        free(filename);
-        free(sectionText);
+    // Load the indexes once for every lookup
+    stringList searchTerms = parseSearchTerms(argc, argv, first);
+    struct rankIndexes indexes;
+    char *error = loadSearchIndexes(&indexes, RANK_TFIDF, &options, searchTerms);
+    if (error != NULL) {
+        printf("%s\n", error);
+        exit(1);
     }
 
-    stringList sorted = sortStringList(urls);
-
-    int numOutput = 0;
-    for (stringNode n = sorted->start; n != NULL; n = n->next) {
-        printf("%s %lf\n", n->string, getTfIdfSum(getNode(urls, n->string)));
-        numOutput++;
-        if (numOutput == 30) break;
+    // Print out matching URLs with their tf-idf, sorted by number of terms
+    // found and tf-idf
+    error = rankSearch(RANK_TFIDF, &indexes, &options, searchTerms, stdout);
+    if (error != NULL) {
+        printf("%s\n", error);
+        exit(1);
     }
-    
+
+    freeRankIndexes(&indexes);
     freeStringList(searchTerms);
-    freeStringList(urls);
-    freeStringList(sorted);
 
     return 0;
 }
-
-// Returns the sum of the tf-idf values for a URL
-double getTfIdfSum(stringNode url) {
-    double sum = 0;
-    for (stringNode n = url->list->start; n != NULL; n = n->next) {
-        sum += n->key;
-    } 
-    return sum;
-}
-
-// Calculates the term frequency of a term within a string
-double calculateTf(char *string, char *term) {
-    stringList words = readWords(string);
-
-    double count = 0;
-    double total = 0;
-
-    for (stringNode n = words->start; n != NULL; n = n->next) {
-        char *word = cleanString(n->string);
-
-        if (strcmp(term, word) == 0) count++;
-        total++;
-
-        free(word);
-    }
-
-    freeStringList(words);
-
-    return count / total;
-}
-
-// Calculates the inverse document frequency for a term
-double calculateIdf(char *collection, char *invertedIndex, char *term) {
-    stringList terms = newStringList();
-    appendToStringList(terms, term);
-    stringList all = readCollection(collection);
-    stringList matches = getMatchingUrls(terms, invertedIndex);
-
-    double numAll = stringListLength(all);
-    double numMatches = stringListLength(matches);
-
-    freeStringList(terms);
-    freeStringList(all);
-    freeStringList(matches);
-
-    if (numMatches == 0) return 0;
-    return log(numAll / numMatches);    
-}
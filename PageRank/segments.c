@@ -0,0 +1,655 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+
+#include "segments.h"
+#include "indexer.h"
+#include "postings.h"
+#include "text.h"
+
+static segment openSegment(char *name, char *indexFile, char *forwardFile,
+    char *positionalFile, char *deletedFile);
+static void closeSegment(segment s);
+static segmentSet openManifestSegments(manifest m, int positional);
+static int sameSegments(manifest m1, manifest m2);
+static void hideOlder(segmentSet set, int newer, char *url);
+static char **readDeleted(char *filename, int *numDeleted);
+static void writeManifest(manifest m);
+static int lockFile(char *filename);
+static int reserveSegment();
+static int commitSegment(char **replaced, int numReplaced, char *name);
+static void removeSegmentFiles(char *name);
+static void mergeRange(segmentSet set, int first, int last, char *name, int positional,
+    int numThreads);
+static termRun readSegmentRun(segment s, int *newIds, int positional);
+
+// Opens the base index and every segment in the manifest, and works out
+// which documents are still live. Positional indexes are only opened if
+// positional is set. Returns NULL if the indexes cannot be opened, with the
+// reason given by getIndexError
+segmentSet openSegments(int positional) {
+    manifest m = readManifest();
+
+    // A merge removes the segments it replaced once the manifest no longer
+    // lists them, so the segments opened are only a consistent snapshot if
+    // the manifest still lists them afterwards. Otherwise open them again
+    while (1) {
+        segmentSet set = openManifestSegments(m, positional);
+        manifest current = readManifest();
+        int consistent = sameSegments(m, current);
+
+        freeManifest(m);
+        m = current;
+        if (consistent) {
+            freeManifest(m);
+            return set;
+        }
+        closeSegments(set);
+    }
+}
+
+// Opens the base index and the segments listed in a manifest, or returns
+// NULL if any of them cannot be opened
+static segmentSet openManifestSegments(manifest m, int positional) {
+    segmentSet set = malloc(sizeof(struct _segmentSet));
+    set->numSegments = m->numSegments + 1;
+    set->segments = calloc(set->numSegments, sizeof(segment));
+    set->firstIds = NULL;
+    set->segments[0] = openSegment(NULL, BASE_INDEX, BASE_FORWARD,
+        positional ? BASE_POSITIONAL : NULL, NULL);
+
+    for (int i = 0; i < m->numSegments && set->segments[i] != NULL; i++) {
+        char *name = m->names[i];
+        char *indexFile = stringJoin(name, ".bin");
+        char *forwardFile = stringJoin(name, ".fwd");
+        char *positionalFile = stringJoin(name, ".pos");
+        char *deletedFile = stringJoin(name, ".del");
+
+        set->segments[i + 1] = openSegment(name, indexFile, forwardFile,
+            positional ? positionalFile : NULL, deletedFile);
+
+        free(indexFile);
+        free(forwardFile);
+        free(positionalFile);
+        free(deletedFile);
+    }
+
+    if (set->segments[set->numSegments - 1] == NULL) {
+        closeSegments(set);
+        return NULL;
+    }
+
+    // Hide the older copies of every URL in each segment, newest first
+    for (int j = set->numSegments - 1; j > 0; j--) {
+        segment s = set->segments[j];
+        for (unsigned int d = 0; d < s->index->header->numDocs; d++) {
+            hideOlder(set, j, getDocUrl(s->index, d));
+        }
+        for (int i = 0; i < s->numDeleted; i++) hideOlder(set, j, s->deleted[i]);
+    }
+
+    set->numDocs = 0;
+    set->numIds = 0;
+    set->firstIds = calloc(set->numSegments, sizeof(int));
+    for (int i = 0; i < set->numSegments; i++) {
+        segment s = set->segments[i];
+        set->numDocs += s->index->header->numDocs - s->numDead;
+        set->firstIds[i] = set->numIds;
+        set->numIds += s->index->header->numDocs;
+    }
+
+    return set;
+}
+
+// Closes every segment and frees the memory occupied by a segment set
+void closeSegments(segmentSet set) {
+    if (set == NULL) return;
+    for (int i = 0; i < set->numSegments; i++) closeSegment(set->segments[i]);
+    free(set->segments);
+    free(set->firstIds);
+    free(set);
+}
+
+// Returns whether a document of a segment has not been replaced or deleted
+int isLiveDoc(segment s, int doc) {
+    return s->dead == NULL || !s->dead[doc];
+}
+
+// Returns the number of the segment holding a document numbered across every
+// segment, and sets doc to its number within that segment
+int getIdSegment(segmentSet set, int id, int *doc) {
+    int low = 0;
+    int high = set->numSegments - 1;
+
+    // Find the last segment whose first ID is not past the given ID
+    while (low < high) {
+        int mid = (low + high + 1) / 2;
+        if (set->firstIds[mid] <= id) low = mid;
+        else high = mid - 1;
+    }
+
+    *doc = id - set->firstIds[low];
+    return low;
+}
+
+// Finds the live document with the given URL. Returns the number of its
+// segment and sets doc, or returns NO_SEGMENT if there is no such document
+int findLiveDoc(segmentSet set, char *url, int *doc) {
+    for (int i = set->numSegments - 1; i >= 0; i--) {
+        int d = findDoc(set->segments[i]->index, url);
+        if (d != NO_DOC && isLiveDoc(set->segments[i], d)) {
+            *doc = d;
+            return i;
+        }
+    }
+    return NO_SEGMENT;
+}
+
+// Returns the number of live documents containing a term
+long getLiveDocFreq(segmentSet set, char *term) {
+    long docFreq = 0;
+
+    for (int i = 0; i < set->numSegments; i++) {
+        segment s = set->segments[i];
+        int t = findTerm(s->index, term);
+        if (t == NO_TERM) continue;
+
+        // Only segments with dead documents need their postings read
+        if (s->dead == NULL) {
+            docFreq += s->index->terms[t].docFreq;
+            continue;
+        }
+
+        int *ids = calloc(s->index->terms[t].docFreq, sizeof(int));
+        int length = readTermPostings(s->index, t, ids);
+        for (int k = 0; k < length; k++) {
+            if (isLiveDoc(s, ids[k])) docFreq++;
+        }
+        free(ids);
+    }
+
+    return docFreq;
+}
+
+// Reads the segment manifest. A missing manifest has no segments
+manifest readManifest() {
+    manifest m = malloc(sizeof(struct _manifest));
+    m->nextNumber = 1;
+    m->numSegments = 0;
+    m->names = NULL;
+
+    FILE *file = fopen(SEGMENT_MANIFEST, "r");
+    if (file == NULL) return m;
+
+    if (fscanf(file, "%d", &m->nextNumber) != 1) m->nextNumber = 1;
+
+    int size = 0;
+    char name[BUFFER_SIZE];
+    while (fscanf(file, "%255s", name) == 1) {
+        if (m->numSegments == size) {
+            size = size == 0 ? 8 : size * 2;
+            m->names = realloc(m->names, size * sizeof(char *));
+        }
+        m->names[m->numSegments] = stringJoin(name, "");
+        m->numSegments++;
+    }
+
+    fclose(file);
+    return m;
+}
+
+// Frees the memory occupied by a manifest
+void freeManifest(manifest m) {
+    for (int i = 0; i < m->numSegments; i++) free(m->names[i]);
+    free(m->names);
+    free(m);
+}
+
+// Removes every segment and the manifest, once a full rebuild of the base
+// index has made them obsolete
+void clearSegments() {
+    int lock = lockFile(SEGMENT_LOCK);
+    manifest m = readManifest();
+
+    for (int i = 0; i < m->numSegments; i++) removeSegmentFiles(m->names[i]);
+    unlink(SEGMENT_MANIFEST);
+
+    freeManifest(m);
+    close(lock);
+}
+
+// Adds a segment holding the current pages of the given URLs, or tombstones
+// for them if deleting is set, and returns its name. The segment is listed
+// in the manifest only once its files are complete
+char *addSegment(char **urls, int numUrls, int deleting, int numThreads) {
+    char name[BUFFER_SIZE];
+    sprintf(name, "segment%d", reserveSegment());
+
+    char *indexFile = stringJoin(name, ".bin");
+    char *forwardFile = stringJoin(name, ".fwd");
+    char *positionalFile = stringJoin(name, ".pos");
+    char *deletedFile = stringJoin(name, ".del");
+
+    // Keep segments positional while the base index is
+    int positional = access(BASE_POSITIONAL, R_OK) == 0;
+
+    docTable docs = newDocTable(urls, deleting ? 0 : numUrls);
+    buildIndex(docs, NULL, indexFile, forwardFile, positional ? positionalFile : NULL, numThreads,
+        NULL);
+    freeDocTable(docs);
+
+    if (deleting) {
+        FILE *file = fopen(deletedFile, "w");
+        if (file == NULL) {
+            printf("ERROR: Could not write tombstones to file '%s'\n", deletedFile);
+            exit(1);
+        }
+        for (int i = 0; i < numUrls; i++) fprintf(file, "%s\n", urls[i]);
+        fclose(file);
+    }
+
+    commitSegment(NULL, 0, name);
+
+    free(indexFile);
+    free(forwardFile);
+    free(positionalFile);
+    free(deletedFile);
+    return stringJoin(name, "");
+}
+
+// Merges segments if the merge policy calls for it, or every segment if all
+// is set, and returns whether a merge was done. The policy merges the
+// MERGE_FACTOR consecutive segments with the fewest documents once there
+// are that many, so small recent segments are merged most often. Only one
+// merge runs at a time
+int mergeSegments(int all, int numThreads) {
+    int lock = open(MERGE_LOCK, O_RDWR | O_CREAT, 0644);
+    if (lock < 0 || flock(lock, LOCK_EX | LOCK_NB) != 0) {
+        if (lock >= 0) close(lock);
+        return 0;
+    }
+
+    int positional = access(BASE_POSITIONAL, R_OK) == 0;
+    segmentSet set = openSegments(positional);
+    if (set == NULL) {
+        printf("%s\n", getIndexError());
+        exit(1);
+    }
+
+    // The base index is never merged, so choose from segments 1 onwards
+    int numSegments = set->numSegments - 1;
+    int first = 1;
+    int count = all ? numSegments : MERGE_FACTOR;
+
+    if (!all && numSegments >= MERGE_FACTOR) {
+        long best = -1;
+        for (int i = 1; i + MERGE_FACTOR <= set->numSegments; i++) {
+            long size = 0;
+            for (int j = i; j < i + MERGE_FACTOR; j++) {
+                segment s = set->segments[j];
+                size += s->index->header->numDocs + s->numDeleted;
+            }
+            if (best < 0 || size < best) {
+                best = size;
+                first = i;
+            }
+        }
+    }
+
+    int merged = 0;
+    if (count >= 2 && count <= numSegments) {
+        char name[BUFFER_SIZE];
+        sprintf(name, "segment%d", reserveSegment());
+        mergeRange(set, first, first + count - 1, name, positional, numThreads);
+
+        char **replaced = calloc(count, sizeof(char *));
+        for (int i = 0; i < count; i++) replaced[i] = set->segments[first + i]->name;
+
+        // Readers may still have the old segments open, but their mapped
+        // files stay readable after removal
+        if (commitSegment(replaced, count, name)) {
+            for (int i = 0; i < count; i++) removeSegmentFiles(replaced[i]);
+            merged = 1;
+        } else {
+            removeSegmentFiles(name);
+        }
+
+        free(replaced);
+    }
+
+    closeSegments(set);
+    close(lock);
+    return merged;
+}
+
+// Opens the files of one segment, or returns NULL if its index or forward
+// index cannot be opened. A NULL positional or deleted file is skipped, and
+// so is a deleted file that does not exist
+static segment openSegment(char *name, char *indexFile, char *forwardFile,
+    char *positionalFile, char *deletedFile) {
+    invertedIndex index = openIndex(indexFile);
+    forwardIndex forward = index == NULL ? NULL : openForwardIndex(forwardFile);
+    if (forward == NULL) {
+        closeIndex(index);
+        return NULL;
+    }
+
+    segment s = malloc(sizeof(struct _segment));
+    s->name = name == NULL ? NULL : stringJoin(name, "");
+    s->index = index;
+    s->forward = forward;
+    s->positions = positionalFile == NULL ? NULL : openPositionalIndex(positionalFile, s->index);
+    s->numDeleted = 0;
+    s->deleted = deletedFile == NULL ? NULL : readDeleted(deletedFile, &s->numDeleted);
+    s->numDead = 0;
+    s->dead = NULL;
+    return s;
+}
+
+// Closes the files of a segment and frees its memory
+static void closeSegment(segment s) {
+    if (s == NULL) return;
+    closeIndex(s->index);
+    closeForwardIndex(s->forward);
+    closePositionalIndex(s->positions);
+    for (int i = 0; i < s->numDeleted; i++) free(s->deleted[i]);
+    free(s->deleted);
+    free(s->dead);
+    free(s->name);
+    free(s);
+}
+
+// Returns whether two manifests list the same segments
+static int sameSegments(manifest m1, manifest m2) {
+    if (m1->numSegments != m2->numSegments) return 0;
+    for (int i = 0; i < m1->numSegments; i++) {
+        if (strcmp(m1->names[i], m2->names[i]) != 0) return 0;
+    }
+    return 1;
+}
+
+// Marks the document with a URL as dead in every segment older than newer
+static void hideOlder(segmentSet set, int newer, char *url) {
+    for (int i = 0; i < newer; i++) {
+        segment s = set->segments[i];
+        int d = findDoc(s->index, url);
+        if (d == NO_DOC) continue;
+
+        if (s->dead == NULL) s->dead = calloc(s->index->header->numDocs, sizeof(unsigned char));
+        if (!s->dead[d]) {
+            s->dead[d] = 1;
+            s->numDead++;
+        }
+    }
+}
+
+// Reads the tombstones of a segment, one URL per line
+static char **readDeleted(char *filename, int *numDeleted) {
+    FILE *file = fopen(filename, "r");
+    *numDeleted = 0;
+    if (file == NULL) return NULL;
+
+    int size = 8;
+    char **deleted = calloc(size, sizeof(char *));
+    char url[BUFFER_SIZE];
+
+    while (fscanf(file, "%255s", url) == 1) {
+        if (*numDeleted == size) {
+            size *= 2;
+            deleted = realloc(deleted, size * sizeof(char *));
+        }
+        deleted[*numDeleted] = stringJoin(url, "");
+        (*numDeleted)++;
+    }
+
+    fclose(file);
+    return deleted;
+}
+
+// Writes the manifest to a temporary file and renames it into place, so
+// readers see either the old or the new list of segments
+static void writeManifest(manifest m) {
+    char *temporary = stringJoin(SEGMENT_MANIFEST, ".tmp");
+    FILE *file = fopen(temporary, "w");
+
+    if (file == NULL) {
+        printf("ERROR: Could not write segment manifest '%s'\n", temporary);
+        exit(1);
+    }
+
+    fprintf(file, "%d\n", m->nextNumber);
+    for (int i = 0; i < m->numSegments; i++) fprintf(file, "%s\n", m->names[i]);
+    fclose(file);
+
+    rename(temporary, SEGMENT_MANIFEST);
+    free(temporary);
+}
+
+// Takes an exclusive lock on a file, waiting until it is free, and returns
+// the descriptor to close to release it
+static int lockFile(char *filename) {
+    int fd = open(filename, O_RDWR | O_CREAT, 0644);
+
+    if (fd < 0 || flock(fd, LOCK_EX) != 0) {
+        printf("ERROR: Could not lock '%s'\n", filename);
+        exit(1);
+    }
+
+    return fd;
+}
+
+// Returns a segment number that no other segment will be given
+static int reserveSegment() {
+    int lock = lockFile(SEGMENT_LOCK);
+    manifest m = readManifest();
+
+    int number = m->nextNumber;
+    m->nextNumber++;
+    writeManifest(m);
+
+    freeManifest(m);
+    close(lock);
+    return number;
+}
+
+// Lists a new segment in the manifest in place of the segments it replaced,
+// or after every other segment if it replaced none. Returns 0 if the
+// replaced segments are no longer listed
+static int commitSegment(char **replaced, int numReplaced, char *name) {
+    int lock = lockFile(SEGMENT_LOCK);
+    manifest m = readManifest();
+
+    // Only merges remove segments, so the replaced ones are still together
+    int first = m->numSegments;
+    if (numReplaced > 0) {
+        first = -1;
+        for (int i = 0; i + numReplaced <= m->numSegments && first < 0; i++) {
+            int matches = 1;
+            for (int j = 0; j < numReplaced; j++) {
+                if (strcmp(m->names[i + j], replaced[j]) != 0) matches = 0;
+            }
+            if (matches) first = i;
+        }
+    }
+
+    if (first < 0) {
+        freeManifest(m);
+        close(lock);
+        return 0;
+    }
+
+    int numSegments = m->numSegments - numReplaced + 1;
+    char **names = calloc(numSegments, sizeof(char *));
+    int n = 0;
+
+    for (int i = 0; i < first; i++) names[n++] = m->names[i];
+    names[n++] = stringJoin(name, "");
+    for (int i = first; i < first + numReplaced; i++) free(m->names[i]);
+    for (int i = first + numReplaced; i < m->numSegments; i++) names[n++] = m->names[i];
+
+    free(m->names);
+    m->names = names;
+    m->numSegments = numSegments;
+    writeManifest(m);
+
+    freeManifest(m);
+    close(lock);
+    return 1;
+}
+
+// Removes every file belonging to a segment
+static void removeSegmentFiles(char *name) {
+    char *extensions[] = {".bin", ".fwd", ".pos", ".del"};
+
+    for (int i = 0; i < 4; i++) {
+        char *filename = stringJoin(name, extensions[i]);
+        unlink(filename);
+        free(filename);
+    }
+}
+
+// Writes the live documents of segments first to last as one new segment,
+// along with their tombstones
+static void mergeRange(segmentSet set, int first, int last, char *name, int positional,
+    int numThreads) {
+    int numRuns = last - first + 1;
+    int **newIds = calloc(numRuns, sizeof(int *));
+
+    int numUrls = 0;
+    for (int i = first; i <= last; i++) numUrls += set->segments[i]->index->header->numDocs;
+    char **urls = calloc(numUrls, sizeof(char *));
+
+    // Number the live documents in segment order, so each segment's run
+    // covers a higher range of IDs than the one before
+    numUrls = 0;
+    for (int i = first; i <= last; i++) {
+        segment s = set->segments[i];
+        newIds[i - first] = calloc(s->index->header->numDocs, sizeof(int));
+
+        for (unsigned int d = 0; d < s->index->header->numDocs; d++) {
+            newIds[i - first][d] = -1;
+            if (isLiveDoc(s, d)) {
+                newIds[i - first][d] = numUrls;
+                urls[numUrls] = getDocUrl(s->index, d);
+                numUrls++;
+            }
+        }
+    }
+
+    docTable docs = newDocTable(urls, numUrls);
+    termRun *runs = calloc(numRuns, sizeof(termRun));
+
+    for (int i = first; i <= last; i++) {
+        segment s = set->segments[i];
+        for (unsigned int d = 0; d < s->index->header->numDocs; d++) {
+            int id = newIds[i - first][d];
+            if (id >= 0) docs->lengths[id] = getDocLength(s->forward, d);
+        }
+        runs[i - first] = readSegmentRun(s, newIds[i - first], positional);
+    }
+
+    char *indexFile = stringJoin(name, ".bin");
+    char *forwardFile = stringJoin(name, ".fwd");
+    char *positionalFile = stringJoin(name, ".pos");
+    char *deletedFile = stringJoin(name, ".del");
+
+    writeRuns(docs, runs, numRuns, NULL, indexFile, forwardFile,
+        positional ? positionalFile : NULL, numThreads);
+
+    // Tombstones still hide documents in older segments, unless the merged
+    // segment holds a newer copy of the URL
+    stringBST seen = NULL;
+    FILE *file = NULL;
+    for (int i = first; i <= last; i++) {
+        segment s = set->segments[i];
+        for (int j = 0; j < s->numDeleted; j++) {
+            char *url = s->deleted[j];
+            int doc;
+            int live = findLiveDoc(set, url, &doc);
+            if ((live >= first && live <= last) || getKeyBST(seen, url) != NULL) continue;
+
+            if (seen == NULL) seen = newStringBST(url);
+            else insertKeyBST(seen, url);
+
+            if (file == NULL) file = fopen(deletedFile, "w");
+            if (file == NULL) {
+                printf("ERROR: Could not write tombstones to file '%s'\n", deletedFile);
+                exit(1);
+            }
+            fprintf(file, "%s\n", url);
+        }
+    }
+
+    if (file != NULL) fclose(file);
+    freeStringBST(seen);
+
+    for (int i = 0; i < numRuns; i++) {
+        freeTermRun(runs[i]);
+        free(newIds[i]);
+    }
+    freeDocTable(docs);
+    free(runs);
+    free(newIds);
+    free(urls);
+    free(indexFile);
+    free(forwardFile);
+    free(positionalFile);
+    free(deletedFile);
+}
+
+// Reads the terms of a segment as a run, keeping only postings of live
+// documents and giving them their new IDs. Terms are numbered in sorted
+// order, so the run comes out sorted
+static termRun readSegmentRun(segment s, int *newIds, int positional) {
+    invertedIndex index = s->index;
+    termRun run = malloc(sizeof(struct _termRun));
+    run->tree = NULL;
+    run->numTerms = 0;
+    run->terms = calloc(index->header->numTerms, sizeof(stringBST));
+
+    int *ids = calloc(index->header->numDocs, sizeof(int));
+    int *positions = NULL;
+    int capacity = 0;
+
+    for (unsigned int t = 0; t < index->header->numTerms; t++) {
+        int length = readTermPostings(index, t, ids);
+        stringBST node = NULL;
+
+        for (int k = 0; k < length; k++) {
+            if (newIds[ids[k]] < 0) continue;
+
+            if (node == NULL) {
+                node = newStringBST(getTermName(index, t));
+                if (positional) node->positions = newIdVector();
+            }
+
+            appendIdVector(node->ids, newIds[ids[k]]);
+            appendIdVector(node->freqs, getTermCount(s->forward, ids[k], t));
+
+            // Positional entries are in the same order as the postings
+            if (positional) {
+                int entry = s->positions->terms[t].docs + k;
+                int count = countPositions(s->positions, entry);
+                if (count > capacity) {
+                    capacity = count;
+                    positions = realloc(positions, capacity * sizeof(int));
+                }
+
+                readPositions(s->positions, entry, positions);
+                for (int p = 0; p < count; p++) appendIdVector(node->positions, positions[p]);
+            }
+        }
+
+        if (node != NULL) {
+            run->terms[run->numTerms] = node;
+            run->numTerms++;
+        }
+    }
+
+    free(ids);
+    free(positions);
+    return run;
+}
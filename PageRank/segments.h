@@ -0,0 +1,72 @@
+#ifndef SEGMENTS_H
+#define SEGMENTS_H
+
+#include "index.h"
+
+#define BASE_INDEX "invertedIndex.bin"
+#define BASE_FORWARD "forwardIndex.bin"
+#define BASE_POSITIONAL "positionalIndex.bin"
+#define BASE_IMPACT "impactIndex.bin"
+#define SEGMENT_MANIFEST "segments.txt"
+#define SEGMENT_LOCK "segments.lock"
+#define MERGE_LOCK "merge.lock"
+
+// Number of segments merged together at a time
+#define MERGE_FACTOR 4
+
+#define NO_SEGMENT -1
+
+typedef struct _segment *segment;
+typedef struct _segmentSet *segmentSet;
+typedef struct _manifest *manifest;
+
+// An immutable part of the index. Tombstones are URLs deleted from older
+// segments. A document is dead if a newer segment holds the same URL as a
+// document or a tombstone
+struct _segment {
+    char *name;
+    invertedIndex index;
+    forwardIndex forward;
+    positionalIndex positions;
+    int numDeleted;
+    char **deleted;
+    int numDead;
+    unsigned char *dead;    // NULL while every document is live
+};
+
+// The base index built by inverted followed by every segment added since,
+// oldest first
+struct _segmentSet {
+    int numSegments;
+    segment *segments;
+    long numDocs;           // Number of live documents
+    int numIds;             // Number of documents in every segment, live or dead
+    int *firstIds;          // ID of each segment's first document, numbering
+                            // the documents of every segment together
+};
+
+// The segments added since the base index, oldest first, with the number
+// of documents and tombstones in each
+struct _manifest {
+    int nextNumber;
+    int numSegments;
+    char **names;
+    int *sizes;
+};
+
+segmentSet openSegments(int positional);
+void closeSegments(segmentSet set);
+
+int isLiveDoc(segment s, int doc);
+int getIdSegment(segmentSet set, int id, int *doc);
+int findLiveDoc(segmentSet set, char *url, int *doc);
+long getLiveDocFreq(segmentSet set, char *term);
+
+manifest readManifest();
+void freeManifest(manifest m);
+void clearSegments();
+
+char *addSegment(char **urls, int numUrls, int deleting, int numThreads);
+int mergeSegments(int all, int numThreads);
+
+#endif
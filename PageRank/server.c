@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "server.h"
+
+static void writeField(FILE *out, char *field);
+
+// Asks a running search server to run a search, and prints its reply. Exits
+// if the reply is an error. Returns 0, having done nothing, if no server is
+// running so that the caller can run the search itself
+int sendSearch(char *program, struct searchOptions *options, int numTerms, char *terms[]) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, SEARCH_SOCKET, sizeof(address.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return 0;
+    if (connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        close(fd);
+        return 0;
+    }
+
+    char *request;
+    size_t requestSize;
+    FILE *out = open_memstream(&request, &requestSize);
+    fprintf(out, "%s%c%d%c%d%c", program, FIELD_SEPARATOR, options->minMatch, FIELD_SEPARATOR,
+        options->impact, FIELD_SEPARATOR);
+    if (options->weighted) {
+        fprintf(out, "%.17g,%.17g,%.17g", options->weights.count, options->weights.tfIdf,
+            options->weights.pagerank);
+    }
+    for (int i = 0; i < numTerms; i++) {
+        fputc(FIELD_SEPARATOR, out);
+        writeField(out, terms[i]);
+    }
+    fputc('\n', out);
+    fclose(out);
+
+    // A server that has gone away must not kill the client
+    int sent = send(fd, request, requestSize, MSG_NOSIGNAL) == (ssize_t)requestSize;
+    free(request);
+    if (!sent) {
+        close(fd);
+        return 0;
+    }
+
+    // Print the reply up to the empty line that ends it
+    FILE *in = fdopen(fd, "r");
+    char *line = NULL;
+    size_t size = 0;
+    int complete = 0;
+    int printed = 0;
+    int failed = 0;
+    while (getline(&line, &size, in) > 0) {
+        if (strcmp(line, "\n") == 0) {
+            complete = 1;
+            break;
+        }
+        if (!printed && strncmp(line, "ERROR:", 6) == 0) failed = 1;
+        fputs(line, stdout);
+        printed = 1;
+    }
+    free(line);
+    fclose(in);
+
+    if (!complete && !printed) return 0;
+    if (!complete) {
+        printf("ERROR: The search server stopped while replying\n");
+        exit(1);
+    }
+    if (failed) exit(1);
+    return 1;
+}
+
+// Splits a request line into its fields, in place, and returns how many
+// there are. The fields last as long as the line
+int splitRequest(char *line, char ***fields) {
+    int numFields = 1;
+    for (char *c = line; *c != '\0'; c++) {
+        if (*c == FIELD_SEPARATOR) numFields++;
+    }
+
+    *fields = calloc(numFields, sizeof(char *));
+    (*fields)[0] = line;
+    int f = 1;
+    for (char *c = line; *c != '\0'; c++) {
+        if (*c == '\n') {
+            *c = '\0';
+            break;
+        }
+        if (*c == FIELD_SEPARATOR) {
+            *c = '\0';
+            (*fields)[f] = c + 1;
+            f++;
+        }
+    }
+
+    return numFields;
+}
+
+// Writes a search term as a field, with any separator or line break in it
+// turned into a space
+static void writeField(FILE *out, char *field) {
+    for (char *c = field; *c != '\0'; c++) {
+        if (*c == FIELD_SEPARATOR || *c == '\n') fputc(' ', out);
+        else fputc(*c, out);
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "search.h"
+
+#define SEARCH_SOCKET "search.sock"
+
+// Requests are one line each: the program asked for, the minimum number of
+// terms to match, whether to rank from impacts, the weights to rank by or
+// nothing for the program's own, then the search terms, all separated by
+// tabs. The reply is the program's output followed by an
+// empty line, and its first line starts with "ERROR:" if the search failed
+#define FIELD_SEPARATOR '\t'
+#define REQUEST_FIELDS 4
+
+// Program asked for to have the server write its cache statistics instead
+#define CACHE_STATS "cacheStats"
+
+int sendSearch(char *program, struct searchOptions *options, int numTerms, char *terms[]);
+int splitRequest(char *line, char ***fields);
+
+#endif
@@ -0,0 +1,532 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "spimi.h"
+#include "indexer.h"
+#include "index.h"
+#include "postings.h"
+#include "text.h"
+#include "loader.h"
+
+// Bytes taken by a term before any postings are added, besides its string
+#define TERM_COST (sizeof(struct _stringBST) + sizeof(struct _collationKey) + \
+    3 * sizeof(struct _idVector))
+
+// A sorted run of terms, read back one term at a time from the mapped file
+// every run is written to. Each term is stored as its length and
+// characters, its number of documents, then a varint gap, frequency and,
+// for a positional index, the position gaps of each document
+struct runReader {
+    unsigned char *next;
+    unsigned char *end;
+    char *term;     // NULL once every term has been read
+    int docFreq;
+};
+
+// The terms written so far, in dictionary order
+struct dictionary {
+    int numTerms;
+    int size;
+    char **names;
+    struct indexTerm *terms;
+    struct positionalTerm *positionalTerms;
+};
+
+static FILE *openTemporary();
+static void writeVarintFile(FILE *file, unsigned int value);
+static int readVarintFile(FILE *file, unsigned int *value);
+static long appendCounted(idVector v, int id);
+static int compareTermKeys(const void *a, const void *b);
+static int compareForwardEntries(const void *a, const void *b);
+static void flushRun(FILE *file, stringBST tree, int numTerms, int positional);
+static void readRunTerm(struct runReader *run);
+static void copyFile(FILE *from, FILE *to);
+static void *mapTemporary(FILE *file, size_t *size);
+static void unmapTemporary(void *map, size_t size);
+static int findDictionaryTerm(struct dictionary *dict, unsigned int *hash,
+    unsigned int hashSize, char *term);
+
+// Builds the same index files as buildInvertedIndex in a single pass over
+// the collection, holding at most about memoryBudget bytes of terms and
+// postings. Whenever the budget is used up, the terms so far are appended
+// to a temporary file as a sorted run, so the number of files open does
+// not grow with the number of runs. The runs are then merged a term at a
+// time, with postings streamed through temporary files, so only the
+// dictionary, document table and one term's document IDs stay in memory
+void buildSpimiIndex(char *collection, char *textOutput, char *binaryOutput,
+    char *forwardOutput, char *positionalOutput, long memoryBudget) {
+    int positional = positionalOutput != NULL;
+    docTable docs = readDocTable(collection);
+
+    // Each document's terms and counts, by name, to build the forward index
+    // from once terms are numbered
+    FILE *docTerms = openTemporary();
+
+    // Every run goes in one file, ending where the next starts
+    FILE *runs = openTemporary();
+    int numRuns = 0;
+    int runsSize = 8;
+    long *runEnds = calloc(runsSize, sizeof(long));
+
+    stringBST words = NULL;
+    int numTerms = 0;
+    long memoryUsed = 0;
+
+    int touchedSize = 64;
+    stringBST *touched = calloc(touchedSize, sizeof(stringBST));
+
+    pageReader pages = openPageReader(docs->urls, docs->numDocs, READ_URING | READ_STORED);
+
+    for (int id = 0; id < docs->numDocs; id++) {
+        char *sectionText = nextPageSection(pages, "Section-2");
+        stringList urlWords = readWords(sectionText);
+        docs->lengths[id] = stringListLength(urlWords);
+
+        int numTouched = 0;
+        int position = 0;
+
+        for (stringNode currW = urlWords->start; currW != NULL; currW = currW->next) {
+            char *word = cleanString(currW->string);
+            stringBST node = getKeyBST(words, word);
+
+            if (node == NULL) {
+                if (words == NULL) node = words = newStringBST(word);
+                else node = insertKeyBST(words, word);
+                if (positional) node->positions = newIdVector();
+                memoryUsed += TERM_COST + 2 * (strlen(word) + 1);
+                numTerms++;
+            }
+
+            idVector ids = node->ids;
+            if (ids->length == 0 || ids->ids[ids->length - 1] != id) {
+                memoryUsed += appendCounted(ids, id);
+                memoryUsed += appendCounted(node->freqs, 1);
+
+                if (numTouched == touchedSize) {
+                    touchedSize *= 2;
+                    touched = realloc(touched, touchedSize * sizeof(stringBST));
+                }
+                touched[numTouched] = node;
+                numTouched++;
+            } else {
+                node->freqs->ids[ids->length - 1]++;
+            }
+
+            if (positional) memoryUsed += appendCounted(node->positions, position);
+
+            position++;
+            free(word);
+        }
+
+        writeVarintFile(docTerms, numTouched);
+        for (int i = 0; i < numTouched; i++) {
+            int length = strlen(touched[i]->key);
+            writeVarintFile(docTerms, length);
+            fwrite(touched[i]->key, 1, length, docTerms);
+            writeVarintFile(docTerms, touched[i]->freqs->ids[touched[i]->freqs->length - 1]);
+        }
+
+        free(sectionText);
+        freeStringList(urlWords);
+
+        // Only flush between documents, so each run covers a whole range
+        // of documents and runs stay in document order
+        if (memoryUsed >= memoryBudget || id == docs->numDocs - 1) {
+            if (numRuns == runsSize) {
+                runsSize *= 2;
+                runEnds = realloc(runEnds, runsSize * sizeof(long));
+            }
+            flushRun(runs, words, numTerms, positional);
+            runEnds[numRuns] = ftell(runs);
+            numRuns++;
+
+            freeStringBST(words);
+            words = NULL;
+            numTerms = 0;
+            memoryUsed = 0;
+        }
+    }
+
+    closePageReader(pages);
+    free(touched);
+
+    size_t runsMapSize;
+    unsigned char *runsMap = mapTemporary(runs, &runsMapSize);
+    struct runReader *readers = calloc(numRuns, sizeof(struct runReader));
+    for (int r = 0; r < numRuns; r++) {
+        readers[r].next = runsMap + (r == 0 ? 0 : runEnds[r - 1]);
+        readers[r].end = runsMap + runEnds[r];
+        readers[r].term = NULL;
+        readRunTerm(&readers[r]);
+    }
+
+    FILE *text = fopen(textOutput, "w");
+    FILE *binary = openReplacement(binaryOutput);
+    FILE *forward = openReplacement(forwardOutput);
+    FILE *positionsFile = positional ? openReplacement(positionalOutput) : NULL;
+
+    if (text == NULL || binary == NULL || forward == NULL || (positional && positionsFile == NULL)) {
+        char *failed = text == NULL ? textOutput : binary == NULL ? binaryOutput :
+            forward == NULL ? forwardOutput : positionalOutput;
+        printf("ERROR: Could not write index to file '%s'\n", failed);
+        exit(1);
+    }
+
+    FILE *postings = openTemporary();
+    FILE *bounds = openTemporary();
+    FILE *positionalDocs = positional ? openTemporary() : NULL;
+    FILE *positions = positional ? openTemporary() : NULL;
+
+    struct dictionary dict;
+    dict.numTerms = 0;
+    dict.size = 64;
+    dict.names = calloc(dict.size, sizeof(char *));
+    dict.terms = calloc(dict.size, sizeof(struct indexTerm));
+    dict.positionalTerms = calloc(dict.size, sizeof(struct positionalTerm));
+
+    int *ids = calloc(docs->numDocs, sizeof(int));
+    int *freqs = calloc(docs->numDocs, sizeof(int));
+    unsigned char *encoded = malloc(skipPostingsBound(docs->numDocs));
+    long numPostings = 0;
+
+    while (1) {
+        // Find the smallest term not yet written
+        char *min = NULL;
+        for (int r = 0; r < numRuns; r++) {
+            if (readers[r].term == NULL) continue;
+            if (min == NULL || compareCollated(readers[r].term, min) < 0) min = readers[r].term;
+        }
+
+        if (min == NULL) break;
+
+        if (dict.numTerms == dict.size) {
+            dict.size *= 2;
+            dict.names = realloc(dict.names, dict.size * sizeof(char *));
+            dict.terms = realloc(dict.terms, dict.size * sizeof(struct indexTerm));
+            dict.positionalTerms = realloc(dict.positionalTerms,
+                dict.size * sizeof(struct positionalTerm));
+        }
+
+        char *name = stringJoin(min, "");
+        struct indexTerm *t = &dict.terms[dict.numTerms];
+        dict.names[dict.numTerms] = name;
+        dict.positionalTerms[dict.numTerms].docs = numPostings;
+        t->postings = ftell(postings);
+
+        // Runs cover ascending ranges of documents, so streaming the term's
+        // postings from each run in turn keeps them sorted
+        int length = 0;
+        for (int r = 0; r < numRuns; r++) {
+            if (readers[r].term == NULL || strcmp(readers[r].term, name) != 0) continue;
+
+            unsigned int doc = 0;
+            for (int k = 0; k < readers[r].docFreq; k++) {
+                doc += decodeVarint(&readers[r].next);
+                unsigned int freq = decodeVarint(&readers[r].next);
+
+                ids[length] = doc;
+                freqs[length] = freq;
+                length++;
+
+                // Positions are stored as gaps in both formats, so copy them
+                if (positional) {
+                    struct positionalDoc entry;
+                    entry.doc = doc;
+                    entry.positions = ftell(positions);
+                    fwrite(&entry, sizeof(struct positionalDoc), 1, positionalDocs);
+
+                    writeVarintFile(positions, freq);
+                    for (unsigned int p = 0; p < freq; p++) {
+                        writeVarintFile(positions, decodeVarint(&readers[r].next));
+                    }
+                }
+
+                numPostings++;
+            }
+
+            readRunTerm(&readers[r]);
+        }
+
+        t->docFreq = length;
+        t->postingsSize = encodeSkipPostings(ids, length, encoded);
+        fwrite(encoded, 1, t->postingsSize, postings);
+        t->bounds = ftell(bounds) / sizeof(float);
+        t->maxTf = writeTermBounds(bounds, ids, freqs, docs->lengths, length);
+        dict.positionalTerms[dict.numTerms].docFreq = length;
+        dict.numTerms++;
+
+        writeTermText(text, docs, name, ids, length);
+    }
+
+    // The term hash is only used while numbering the terms of each document
+    // below. Keep it at most half full
+    unsigned int hashSize = 1;
+    while (hashSize < 2 * (unsigned int)dict.numTerms) hashSize *= 2;
+    unsigned int *hash = calloc(hashSize, sizeof(unsigned int));
+
+    for (int i = 0; i < dict.numTerms; i++) {
+        unsigned int slot = hashTerm(dict.names[i]) & (hashSize - 1);
+        while (hash[slot] != 0) slot = (slot + 1) & (hashSize - 1);
+        hash[slot] = i + 1;
+    }
+
+    // The merged terms are written as a single range, with their postings
+    // and bounds mapped from the temporary files they were streamed to
+    struct termRange range;
+    range.numTerms = dict.numTerms;
+    range.names = dict.names;
+    range.terms = dict.terms;
+    range.postings = mapTemporary(postings, &range.postingsSize);
+    range.bounds = mapTemporary(bounds, &range.boundsSize);
+    writeBinaryIndex(binary, docs, &range, 1);
+
+    // Number each document's terms and write its entries in term order
+    struct forwardDoc *forwardDocs = calloc(docs->numDocs, sizeof(struct forwardDoc));
+    FILE *forwardEntries = openTemporary();
+    int entriesSize = 64;
+    struct forwardEntry *entries = calloc(entriesSize, sizeof(struct forwardEntry));
+    int keySize = BUFFER_SIZE;
+    char *key = malloc(keySize);
+    long numEntries = 0;
+
+    rewind(docTerms);
+    for (int d = 0; d < docs->numDocs; d++) {
+        unsigned int numDocTerms;
+        readVarintFile(docTerms, &numDocTerms);
+
+        if ((int)numDocTerms > entriesSize) {
+            entriesSize = numDocTerms;
+            entries = realloc(entries, entriesSize * sizeof(struct forwardEntry));
+        }
+
+        for (unsigned int i = 0; i < numDocTerms; i++) {
+            unsigned int length;
+            readVarintFile(docTerms, &length);
+            if ((int)length >= keySize) {
+                keySize = length + 1;
+                key = realloc(key, keySize);
+            }
+            if (fread(key, 1, length, docTerms) != length) length = 0;
+            key[length] = '\0';
+
+            entries[i].term = findDictionaryTerm(&dict, hash, hashSize, key);
+            readVarintFile(docTerms, &entries[i].count);
+        }
+
+        qsort(entries, numDocTerms, sizeof(struct forwardEntry), compareForwardEntries);
+        fwrite(entries, sizeof(struct forwardEntry), numDocTerms, forwardEntries);
+
+        forwardDocs[d].numTerms = numDocTerms;
+        forwardDocs[d].entries = numEntries;
+        numEntries += numDocTerms;
+    }
+
+    size_t forwardSize;
+    struct forwardEntry *forwardMap = mapTemporary(forwardEntries, &forwardSize);
+    writeForwardIndex(forward, docs, forwardDocs, forwardMap, numEntries);
+
+    if (positional) {
+        struct positionalHeader positionalHeader;
+        positionalHeader.magic = POSITIONAL_MAGIC;
+        positionalHeader.version = POSITIONAL_VERSION;
+        positionalHeader.numTerms = dict.numTerms;
+        positionalHeader.numDocs = numPostings;
+        positionalHeader.indexDocs = docs->numDocs;
+        positionalHeader.termsOffset = sizeof(struct positionalHeader);
+        positionalHeader.docsOffset = positionalHeader.termsOffset +
+            dict.numTerms * sizeof(struct positionalTerm);
+        positionalHeader.positionsOffset = positionalHeader.docsOffset +
+            numPostings * sizeof(struct positionalDoc);
+
+        fwrite(&positionalHeader, sizeof(struct positionalHeader), 1, positionsFile);
+        fwrite(dict.positionalTerms, sizeof(struct positionalTerm), dict.numTerms, positionsFile);
+        copyFile(positionalDocs, positionsFile);
+        copyFile(positions, positionsFile);
+        commitReplacement(positionsFile, positionalOutput);
+        fclose(positionalDocs);
+        fclose(positions);
+    }
+
+    unmapTemporary(range.postings, range.postingsSize);
+    unmapTemporary(range.bounds, range.boundsSize);
+    unmapTemporary(forwardMap, forwardSize);
+
+    fclose(text);
+    commitReplacement(binary, binaryOutput);
+    commitReplacement(forward, forwardOutput);
+    fclose(postings);
+    fclose(bounds);
+    fclose(forwardEntries);
+    fclose(docTerms);
+
+    unmapTemporary(runsMap, runsMapSize);
+    fclose(runs);
+    for (int r = 0; r < numRuns; r++) free(readers[r].term);
+    for (int i = 0; i < dict.numTerms; i++) free(dict.names[i]);
+
+    free(dict.names);
+    free(dict.terms);
+    free(dict.positionalTerms);
+    free(runEnds);
+    free(readers);
+    free(ids);
+    free(freqs);
+    free(encoded);
+    free(hash);
+    free(forwardDocs);
+    free(entries);
+    free(key);
+    freeDocTable(docs);
+}
+
+// Opens a temporary file that is removed once closed
+static FILE *openTemporary() {
+    FILE *file = tmpfile();
+    if (file == NULL) {
+        printf("ERROR: Could not create a temporary file\n");
+        exit(1);
+    }
+    return file;
+}
+
+static void writeVarintFile(FILE *file, unsigned int value) {
+    unsigned char encoded[MAX_VARINT];
+    fwrite(encoded, 1, encodeVarint(value, encoded), file);
+}
+
+// Reads a varint from a file, and returns 0 if the file has ended
+static int readVarintFile(FILE *file, unsigned int *value) {
+    unsigned char encoded[MAX_VARINT];
+    int length = 0;
+    int c;
+
+    do {
+        c = fgetc(file);
+        if (c == EOF) return 0;
+        encoded[length] = c;
+        length++;
+    } while ((c & 0x80) && length < MAX_VARINT);
+
+    unsigned char *in = encoded;
+    *value = decodeVarint(&in);
+    return 1;
+}
+
+// Appends an ID to a vector, and returns how many bytes the vector grew by
+static long appendCounted(idVector v, int id) {
+    int capacity = v->capacity;
+    appendIdVector(v, id);
+    return (long)(v->capacity - capacity) * sizeof(int);
+}
+
+static int compareTermKeys(const void *a, const void *b) {
+    return compareCollated((*(stringBST *)a)->key, (*(stringBST *)b)->key);
+}
+
+static int compareForwardEntries(const void *a, const void *b) {
+    const struct forwardEntry *entry1 = a;
+    const struct forwardEntry *entry2 = b;
+    return (entry1->term > entry2->term) - (entry1->term < entry2->term);
+}
+
+// Appends the terms of a BST to the temporary file of runs as a sorted run
+static void flushRun(FILE *file, stringBST tree, int numTerms, int positional) {
+    stringBST *terms = calloc(numTerms, sizeof(stringBST));
+    int pos = 0;
+
+    collectBST(tree, terms, &pos);
+    qsort(terms, numTerms, sizeof(stringBST), compareTermKeys);
+
+    for (int i = 0; i < numTerms; i++) {
+        stringBST term = terms[i];
+        int length = strlen(term->key);
+        writeVarintFile(file, length);
+        fwrite(term->key, 1, length, file);
+        writeVarintFile(file, term->ids->length);
+
+        int prev = 0;
+        int *positions = positional ? term->positions->ids : NULL;
+        for (int k = 0; k < term->ids->length; k++) {
+            int freq = term->freqs->ids[k];
+            writeVarintFile(file, term->ids->ids[k] - prev);
+            writeVarintFile(file, freq);
+            prev = term->ids->ids[k];
+
+            // Positions restart from zero in each document
+            for (int p = 0; positional && p < freq; p++) {
+                writeVarintFile(file, positions[p] - (p == 0 ? 0 : positions[p - 1]));
+            }
+            if (positional) positions += freq;
+        }
+    }
+
+    free(terms);
+}
+
+// Moves a run on to its next term, or sets its term to NULL at the end
+static void readRunTerm(struct runReader *run) {
+    free(run->term);
+    run->term = NULL;
+    if (run->next >= run->end) return;
+
+    unsigned int length = decodeVarint(&run->next);
+    if (run->next + length >= run->end) {
+        printf("ERROR: Could not read a temporary index run\n");
+        exit(1);
+    }
+
+    run->term = calloc(length + 1, sizeof(char));
+    memcpy(run->term, run->next, length);
+    run->next += length;
+    run->docFreq = decodeVarint(&run->next);
+}
+
+// Appends the whole of a temporary file to another file
+static void copyFile(FILE *from, FILE *to) {
+    char buffer[COLLECTION_CHUNK];
+    size_t length;
+
+    rewind(from);
+    while ((length = fread(buffer, 1, sizeof(buffer), from)) > 0) {
+        fwrite(buffer, 1, length, to);
+    }
+}
+
+// Maps the whole of a temporary file into memory, and sets its size. An
+// empty file cannot be mapped, so gets a placeholder that is never read
+static void *mapTemporary(FILE *file, size_t *size) {
+    static char empty;
+
+    fflush(file);
+    fseek(file, 0, SEEK_END);
+    *size = ftell(file);
+    if (*size == 0) return &empty;
+
+    void *map = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+    if (map == MAP_FAILED) {
+        printf("ERROR: Could not map a temporary file\n");
+        exit(1);
+    }
+    return map;
+}
+
+// Unmaps a temporary file mapped by mapTemporary
+static void unmapTemporary(void *map, size_t size) {
+    if (size > 0) munmap(map, size);
+}
+
+// Returns the number of a term in the dictionary being built
+static int findDictionaryTerm(struct dictionary *dict, unsigned int *hash,
+    unsigned int hashSize, char *term) {
+    unsigned int slot = hashTerm(term) & (hashSize - 1);
+
+    while (hash[slot] != 0) {
+        int t = hash[slot] - 1;
+        if (strcmp(dict->names[t], term) == 0) return t;
+        slot = (slot + 1) & (hashSize - 1);
+    }
+
+    return NO_TERM;
+}
@@ -0,0 +1,9 @@
+#ifndef SPIMI_H
+#define SPIMI_H
+
+#define MEGABYTE (1024L * 1024L)
+
+void buildSpimiIndex(char *collection, char *textOutput, char *binaryOutput,
+    char *forwardOutput, char *positionalOutput, long memoryBudget);
+
+#endif
@@ -1,25 +1,73 @@
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 
 #include "text.h"
 #include "graph.h"
+#include "postings.h"
+#include "phrase.h"
+#include "index.h"
+#include "indexer.h"
+#include "accumulator.h"
+#include "impact.h"
+#include "fst.h"
+#include "bloom.h"
+#include "cache.h"
+#include "search.h"
+#include "segments.h"
+#include "rank.h"
+#include "docstore.h"
+#include "loader.h"
 
 #include "string.h"
 
 void testCleanString();
 void testStringSort();
+void testCollation();
 void testInsertSorted();
 void testStringOps();
 void testGraph();
 void testBST();
+void testEmptyIndex();
+void testPostings();
+void testPhrase();
+void testStalePositional();
+void testSegments();
+void testAccumulators();
+void testRankedOrder();
+void testImpactRanking();
+void testPageStore();
+void testFst();
+void testBloom();
+void testCache();
+
+static void writeTestPage(char *url, char *words);
+static char *searchSegments(char *term);
 
 int main(void) {
     testCleanString();
     testStringSort();
+    testCollation();
     testInsertSorted();
-    //testStringOps();
+    testStringOps();
     testGraph();
     testBST();
+    testEmptyIndex();
+    testPostings();
+    testPhrase();
+    testStalePositional();
+    testSegments();
+    testAccumulators();
+    testRankedOrder();
+    testImpactRanking();
+    testPageStore();
+    testFst();
+    testBloom();
+    testCache();
     return 0;
 }
 
@@ -43,6 +91,31 @@ void testStringSort() {
     assert(stringsSorted("mars", "mers") == 1);
 }
 
+void testCollation() {
+    char *strings[] = {"", "a", "B", "abc", "Abd", "url12", "url13", "url1",
+        "jupiter", "JUPITER", "jupiterjupiter", "jupiterjupitor", "mars",
+        "saturnsaturnsaturnsaturnsaturnsaturnsaturnsaturnsaturnsaturnsaturnsaturnA",
+        "saturnsaturnsaturnsaturnsaturnsaturnsaturnsaturnsaturnsaturnsaturnsaturnb"};
+    int num = sizeof(strings) / sizeof(strings[0]);
+
+    // Collation keys must order exactly as stringsSorted does
+    for (int i = 0; i < num; i++) {
+        for (int j = 0; j < num; j++) {
+            collationKey key1 = newCollationKey(strings[i]);
+            collationKey key2 = newCollationKey(strings[j]);
+            assert(collationSorted(key1, key2) == stringsSorted(strings[i], strings[j]));
+
+            // Comparing strings directly must agree with comparing keys
+            int cmp = collationCompare(key1, key2);
+            if (cmp == 0) cmp = strcmp(strings[i], strings[j]);
+            assert((cmp < 0) == (compareCollated(strings[i], strings[j]) < 0));
+            assert((cmp > 0) == (compareCollated(strings[i], strings[j]) > 0));
+            freeCollationKey(key1);
+            freeCollationKey(key2);
+        }
+    }
+}
+
 void testInsertSorted() {
     stringList l = newStringList();
     appendToStringList(l, "a");
@@ -61,7 +134,20 @@ void testInsertSorted() {
 }
 
 void testStringOps() {
+    char *page = "#start Section-1\nurl1 url2\n#end Section-1\n\n"
+        "#start Section-2\nSome words\nmore words\n#end Section-2\n";
+
+    char *section = findSection(page, "Section-1");
+    assert(strcmp(section, "url1 url2\n") == 0);
+    free(section);
 
+    section = findSection(page, "Section-2");
+    assert(strcmp(section, "Some words\nmore words\n") == 0);
+    free(section);
+
+    section = findSection("#start Section-2\nno end", "Section-2");
+    assert(strcmp(section, "no end") == 0);
+    free(section);
 }
 
 void testGraph() {
@@ -83,5 +169,504 @@ void testBST() {
     insertKeyBST(test, "e");
     insertKeyBST(test, "c");
 
+    // Keys too long for a probe's stack buffer are still found
+    char longKey[100];
+    memset(longKey, 'x', sizeof(longKey) - 1);
+    longKey[sizeof(longKey) - 1] = '\0';
+    insertKeyBST(test, longKey);
+    assert(getKeyBST(test, longKey) != NULL);
+    longKey[50] = 'y';
+    assert(getKeyBST(test, longKey) == NULL);
+
     printBST(test);
-}
\ No newline at end of file
+}
+
+void testEmptyIndex() {
+    char *urls[] = {"url1", "url2", "url3"};
+    docTable docs = newDocTable(urls, 3);
+
+    // Pages with no words give empty runs, however many threads merge them
+    termRun runs[3];
+    for (int i = 0; i < 3; i++) {
+        runs[i] = malloc(sizeof(struct _termRun));
+        runs[i]->tree = NULL;
+        runs[i]->numTerms = 0;
+        runs[i]->terms = calloc(0, sizeof(stringBST));
+    }
+    writeRuns(docs, runs, 3, NULL, "emptyIndex.bin", "emptyForward.bin", NULL, 4);
+
+    invertedIndex index = openIndex("emptyIndex.bin");
+    assert(index->header->numTerms == 0);
+    assert(index->header->numDocs == 3);
+    assert(findTerm(index, "mars") == NO_TERM);
+    assert(findDoc(index, "url2") == 1);
+    closeIndex(index);
+
+    remove("emptyIndex.bin");
+    remove("emptyForward.bin");
+    for (int i = 0; i < 3; i++) freeTermRun(runs[i]);
+    freeDocTable(docs);
+}
+
+void testPostings() {
+    unsigned char buffer[5 * MAX_VARINT];
+    unsigned char *p = buffer;
+    assert(encodeVarint(127, buffer) == 1);
+    assert(encodeVarint(128, buffer) == 2);
+    assert(decodeVarint(&p) == 128);
+    assert(p == buffer + 2);
+
+    int ids[] = {0, 3, 130, 20000, 2000000000};
+    int decoded[5];
+    int size = encodePostings(ids, 5, buffer);
+    assert(size == 1 + 1 + 1 + 3 + 5);
+    assert(decodePostings(buffer, 5, decoded) == buffer + size);
+    for (int i = 0; i < 5; i++) assert(decoded[i] == ids[i]);
+
+    // Seeking must land on the same postings as stepping, across skip blocks
+    int many[1000];
+    for (int i = 0; i < 1000; i++) many[i] = i * 3;
+    unsigned char *encoded = malloc(skipPostingsBound(1000));
+    encodeSkipPostings(many, 1000, encoded);
+
+    struct postingCursor cursor;
+    openCursor(&cursor, encoded, 1000);
+    assert(nextPosting(&cursor) == 0);
+    assert(nextPosting(&cursor) == 3);
+    assert(seekPosting(&cursor, 3) == 3);
+    assert(seekPosting(&cursor, 200) == 201);
+    assert(seekPosting(&cursor, 1500) == 1500);
+    assert(nextPosting(&cursor) == 1503);
+    assert(seekPosting(&cursor, 2997) == 2997);
+    assert(nextPosting(&cursor) == END_POSTING);
+    assert(seekPosting(&cursor, 5000) == END_POSTING);
+
+    // Blocks are found without moving the cursor
+    int lastDoc;
+    openCursor(&cursor, encoded, 1000);
+    assert(findPostingBlock(&cursor, 200, &lastDoc) == 1);
+    assert(lastDoc == 127 * 3);
+    assert(findPostingBlock(&cursor, 2997, &lastDoc) == 15);
+    assert(lastDoc == END_POSTING - 1);
+    assert(nextPosting(&cursor) == 0);
+    free(encoded);
+
+    // Term frequency bounds round up rather than to nearest
+    assert(boundTf(1, 3) >= 1.0 / 3);
+    assert(boundTf(2, 7) >= 2.0 / 7);
+
+    // Impacts round up, and stay within their levels
+    assert(quantiseImpact(10, 10.0 / IMPACT_LEVELS) == IMPACT_LEVELS);
+    assert(quantiseImpact(1, 10.0 / IMPACT_LEVELS) == 26);
+    assert(quantiseImpact(0.001, 10.0 / IMPACT_LEVELS) == 1);
+    assert(quantiseImpact(20, 10.0 / IMPACT_LEVELS) == IMPACT_LEVELS);
+}
+
+void testPhrase() {
+    assert(strcmp(cleanPhrase("The  Quick, brown"), "the quick brown") == 0);
+    assert(strcmp(cleanPhrase("quick fox~2"), "quick fox~2") == 0);
+    assert(strcmp(cleanPhrase("fox~2"), "fox") == 0);
+    assert(isPhrase("quick fox~2"));
+    assert(!isPhrase("fox"));
+
+    phrase p = parsePhrase("quick fox~2");
+    assert(p->numWords == 2);
+    assert(strcmp(p->words[1], "fox") == 0);
+    assert(p->slop == 2);
+    freePhrase(p);
+
+    char line[] = " quick \"brown  fox~2\"\tjump*\n";
+    char **terms;
+    assert(splitSearchLine(line, &terms) == 3);
+    assert(strcmp(terms[0], "quick") == 0);
+    assert(strcmp(terms[1], "brown  fox~2") == 0);
+    assert(strcmp(terms[2], "jump*") == 0);
+    free(terms);
+
+    struct rankWeights weights;
+    assert(parseWeights("1,0.5,2", &weights) && weights.tfIdf == 0.5 && weights.pagerank == 2);
+    assert(!parseWeights("1,2", &weights));
+    assert(!parseWeights("1,2,3x", &weights));
+}
+
+void testStalePositional() {
+    char cwd[MAX_LINE];
+    char dir[] = "/tmp/positionalTestXXXXXX";
+    assert(getcwd(cwd, sizeof(cwd)) != NULL);
+    assert(mkdtemp(dir) != NULL && chdir(dir) == 0);
+
+    char *urls[] = {"url1", "url2"};
+    char *words[] = {"the quick brown fox", "a slow dog"};
+    FILE *collection = fopen("collection.txt", "w");
+    for (int p = 0; p < 2; p++) {
+        fprintf(collection, "%s\n", urls[p]);
+        char *filename = stringJoin(urls[p], ".txt");
+        FILE *page = fopen(filename, "w");
+        fprintf(page, "#start Section-1\n#end Section-1\n#start Section-2\n%s\n#end Section-2\n", words[p]);
+        fclose(page);
+        free(filename);
+    }
+    fclose(collection);
+
+    buildInvertedIndex("collection.txt", NULL, BASE_INDEX, BASE_FORWARD, BASE_POSITIONAL, 1);
+    invertedIndex index = openIndex(BASE_INDEX);
+    positionalIndex positions = openPositionalIndex(BASE_POSITIONAL, index);
+    assert(positions != NULL);
+    closePositionalIndex(positions);
+    closeIndex(index);
+
+    // A rebuild without positions leaves the old positional index behind,
+    // which must not be taken as belonging to the new inverted index
+    FILE *page = fopen("url2.txt", "w");
+    fprintf(page, "#start Section-1\n#end Section-1\n#start Section-2\nquick brown dog\n#end Section-2\n");
+    fclose(page);
+    buildInvertedIndex("collection.txt", NULL, BASE_INDEX, BASE_FORWARD, NULL, 1);
+    index = openIndex(BASE_INDEX);
+    assert(openPositionalIndex(BASE_POSITIONAL, index) == NULL);
+    closeIndex(index);
+
+    struct rankIndexes indexes;
+    assert(loadRankIndexes(&indexes) == NULL);
+    stringList terms = newStringList();
+    appendToStringList(terms, "quick brown");
+    struct searchOptions options;
+    memset(&options, 0, sizeof(options));
+    options.minMatch = MATCH_ANY;
+    char *error = rankSearch(RANK_TFIDF, &indexes, &options, terms, stdout);
+    assert(error != NULL && strcmp(error, PHRASE_INDEX_ERROR) == 0);
+    freeStringList(terms);
+    freeRankIndexes(&indexes);
+
+    remove("url1.txt");
+    remove("url2.txt");
+    remove("collection.txt");
+    remove(BASE_INDEX);
+    remove(BASE_FORWARD);
+    remove(BASE_POSITIONAL);
+    assert(chdir(cwd) == 0 && rmdir(dir) == 0);
+}
+
+// Writes a page whose Section-2 holds the words given
+static void writeTestPage(char *url, char *words) {
+    char *filename = stringJoin(url, ".txt");
+    FILE *page = fopen(filename, "w");
+    fprintf(page, "#start Section-1\n#end Section-1\n#start Section-2\n%s\n#end Section-2\n", words);
+    fclose(page);
+    free(filename);
+}
+
+// Returns what a tf-idf search for one term prints
+static char *searchSegments(char *term) {
+    struct rankIndexes indexes;
+    assert(loadRankIndexes(&indexes) == NULL);
+    stringList terms = newStringList();
+    appendToStringList(terms, term);
+
+    struct searchOptions options;
+    memset(&options, 0, sizeof(options));
+    options.minMatch = MATCH_ANY;
+    char *results;
+    size_t size;
+    FILE *out = open_memstream(&results, &size);
+    assert(rankSearch(RANK_TFIDF, &indexes, &options, terms, out) == NULL);
+    fclose(out);
+
+    freeStringList(terms);
+    freeRankIndexes(&indexes);
+    return results;
+}
+
+void testSegments() {
+    char cwd[MAX_LINE];
+    char dir[] = "/tmp/segmentTestXXXXXX";
+    assert(getcwd(cwd, sizeof(cwd)) != NULL);
+    assert(mkdtemp(dir) != NULL && chdir(dir) == 0);
+
+    char *urls[] = {"url1", "url2", "url3", "url4"};
+    char *words[] = {"alpha common", "beta common", "gamma common", "delta common"};
+    FILE *collection = fopen("collection.txt", "w");
+    for (int p = 0; p < 4; p++) {
+        fprintf(collection, "%s\n", urls[p]);
+        writeTestPage(urls[p], words[p]);
+    }
+    fclose(collection);
+    buildInvertedIndex("collection.txt", NULL, BASE_INDEX, BASE_FORWARD, NULL, 1);
+
+    // One segment replaces url2 and the next deletes url3
+    writeTestPage("url2", "epsilon common");
+    free(addSegment(urls + 1, 1, 0, 1));
+    free(addSegment(urls + 2, 1, 1, 1));
+
+    char *queries[] = {"epsilon", "beta", "gamma", "common"};
+    char *before[4];
+    for (int merged = 0; merged < 2; merged++) {
+        segmentSet set = openSegments(0);
+        assert(set != NULL && set->numSegments == (merged ? 2 : 3));
+        assert(set->numDocs == 3);
+
+        int doc;
+        assert(findLiveDoc(set, "url1", &doc) == 0);
+        assert(findLiveDoc(set, "url2", &doc) == 1 && doc == 0);
+        assert(findLiveDoc(set, "url3", &doc) == NO_SEGMENT);
+        assert(findLiveDoc(set, "url4", &doc) == 0 && doc == 3);
+        assert(getLiveDocFreq(set, "common") == 3);
+        closeSegments(set);
+
+        for (int q = 0; q < 4; q++) {
+            char *results = searchSegments(queries[q]);
+            if (!merged) before[q] = results;
+            else {
+                assert(strcmp(results, before[q]) == 0);
+                free(results);
+            }
+        }
+
+        // Two segments are fewer than the policy merges, so only merging
+        // every segment joins them
+        if (!merged) {
+            assert(mergeSegments(0, 1) == 0);
+            assert(mergeSegments(1, 1) == 1);
+            assert(access("segment1.bin", F_OK) != 0 && access("segment2.del", F_OK) != 0);
+        }
+    }
+
+    assert(strstr(before[0], "url2") != NULL);
+    assert(before[1][0] == '\0' && before[2][0] == '\0');
+    assert(strstr(before[3], "url1") != NULL && strstr(before[3], "url3") == NULL);
+    for (int q = 0; q < 4; q++) free(before[q]);
+
+    clearSegments();
+    for (int p = 0; p < 4; p++) {
+        char *filename = stringJoin(urls[p], ".txt");
+        remove(filename);
+        free(filename);
+    }
+    remove("collection.txt");
+    remove(BASE_INDEX);
+    remove(BASE_FORWARD);
+    remove(SEGMENT_LOCK);
+    remove(MERGE_LOCK);
+    assert(chdir(cwd) == 0 && rmdir(dir) == 0);
+}
+
+void testAccumulators() {
+    accumulators acc = newAccumulators(10);
+    addScore(acc, 7, 0.5);
+    addScore(acc, 2, 1.0);
+    addScore(acc, 7, 0.25);
+    assert(acc->numTouched == 2);
+    assert(acc->touched[0] == 7);
+    assert(acc->counts[7] == 2);
+    assert(acc->scores[7] == 0.75);
+
+    // Clearing only resets the documents that were touched
+    clearAccumulators(acc);
+    assert(acc->numTouched == 0);
+    assert(acc->counts[7] == 0 && acc->scores[2] == 0);
+    freeAccumulators(acc);
+}
+
+void testRankedOrder() {
+    struct rankedDoc docs[] = {
+        {1.5, 0.5, 0, "url55"}, {2.0, 1.0, 1, "url9"}, {1.5, 0.5, 2, "url22"},
+        {1.5, 0.5, 3, "url3"}, {1.5, 0.5, 4, "URL3"}};
+    char *expected[] = {"url9", "url22", "URL3", "url3", "url55"};
+    int num = sizeof(docs) / sizeof(docs[0]);
+
+    // Best key first, then equal keys in URL order, not the order found
+    qsort(docs, num, sizeof(struct rankedDoc), compareRankedDocs);
+    for (int i = 0; i < num; i++) assert(strcmp(docs[i].url, expected[i]) == 0);
+}
+
+void testImpactRanking() {
+    char cwd[MAX_LINE];
+    char dir[] = "/tmp/impactTestXXXXXX";
+    assert(getcwd(cwd, sizeof(cwd)) != NULL);
+    assert(mkdtemp(dir) != NULL && chdir(dir) == 0);
+
+    // Pages of words drawn with Zipf frequencies, so common words share
+    // contributions that a coarse quantisation would not tell apart
+    int numPages = 200;
+    unsigned int seed = 12345;
+    char url[BUFFER_SIZE];
+    FILE *collection = fopen("collection.txt", "w");
+    for (int p = 0; p < numPages; p++) {
+        sprintf(url, "url%d", p);
+        fprintf(collection, "%s\n", url);
+
+        char *filename = stringJoin(url, ".txt");
+        FILE *page = fopen(filename, "w");
+        fprintf(page, "#start Section-1\n#end Section-1\n#start Section-2\n");
+        seed = seed * 1103515245 + 12345;
+        int numWords = 5 + seed % 60;
+        for (int w = 0; w < numWords; w++) {
+            seed = seed * 1103515245 + 12345;
+            fprintf(page, "w%d ", (int)pow(100, (seed >> 8) % 10000 / 10000.0));
+        }
+        fprintf(page, "\n#end Section-2\n");
+        fclose(page);
+        free(filename);
+    }
+    fclose(collection);
+
+    buildInvertedIndex("collection.txt", NULL, BASE_INDEX, BASE_FORWARD, NULL, 2);
+    buildImpactIndex(BASE_INDEX, BASE_FORWARD, BASE_IMPACT);
+
+    // Ranking from impacts must give exactly what the exact ranker gives
+    char *queries[][3] = {{"w1", NULL}, {"w2", NULL}, {"w1", "w2", NULL}, {"w3", "w7", "w20"},
+        {"w5", "w40", NULL}, {"w60", "w1", NULL}, {"w90", NULL}, {"w2", "w3", "w4"}};
+    struct rankIndexes indexes;
+    assert(loadRankIndexes(&indexes) == NULL);
+
+    for (int i = 0; i < (int)(sizeof(queries) / sizeof(queries[0])); i++) {
+        stringList terms = newStringList();
+        for (int t = 0; t < 3 && queries[i][t] != NULL; t++) appendToStringList(terms, queries[i][t]);
+
+        char *results[2];
+        size_t sizes[2];
+        for (int impact = 0; impact < 2; impact++) {
+            struct searchOptions options;
+            memset(&options, 0, sizeof(options));
+            options.minMatch = MATCH_ANY;
+            options.impact = impact;
+
+            FILE *out = open_memstream(&results[impact], &sizes[impact]);
+            assert(rankSearch(RANK_TFIDF, &indexes, &options, terms, out) == NULL);
+            fclose(out);
+        }
+
+        assert(sizes[0] > 0 && strcmp(results[0], results[1]) == 0);
+        free(results[0]);
+        free(results[1]);
+        freeStringList(terms);
+    }
+    freeRankIndexes(&indexes);
+
+    for (int p = 0; p < numPages; p++) {
+        sprintf(url, "url%d.txt", p);
+        remove(url);
+    }
+    remove("collection.txt");
+    remove(BASE_INDEX);
+    remove(BASE_FORWARD);
+    remove(BASE_IMPACT);
+    assert(chdir(cwd) == 0 && rmdir(dir) == 0);
+}
+
+void testPageStore() {
+    char cwd[MAX_LINE];
+    char dir[] = "/tmp/pageStoreTestXXXXXX";
+    assert(getcwd(cwd, sizeof(cwd)) != NULL);
+    assert(mkdtemp(dir) != NULL && chdir(dir) == 0);
+
+    char *urls[] = {"url1", "url2", "url3"};
+    char *contents[] = {"one\n", "two\n", "six\n"};
+    FILE *collection = fopen("collection.txt", "w");
+    for (int p = 0; p < 3; p++) {
+        fprintf(collection, "%s\n", urls[p]);
+        char *filename = stringJoin(urls[p], ".txt");
+        FILE *page = fopen(filename, "w");
+        fputs(contents[p], page);
+        fclose(page);
+        free(filename);
+    }
+    fclose(collection);
+    writePageStore("collection.txt", PAGE_STORE);
+
+    // A page grown since packing, and one rewritten at the same size but
+    // with a later modification time, are read from their files
+    FILE *page = fopen("url2.txt", "a");
+    fputs("more\n", page);
+    fclose(page);
+    page = fopen("url3.txt", "w");
+    fputs("ten\n", page);
+    fclose(page);
+    struct timespec times[2] = {{0, UTIME_OMIT}, {0, 0}};
+    struct stat info;
+    assert(stat("url3.txt", &info) == 0);
+    times[1].tv_sec = info.st_mtim.tv_sec + 10;
+    assert(utimensat(AT_FDCWD, "url3.txt", times, 0) == 0);
+
+    char *expected[] = {"one\n", "two\nmore\n", "ten\n"};
+    pageReader reader = openPageReader(urls, 3, READ_STORED);
+    for (int p = 0; p < 3; p++) {
+        assert(strcmp(nextPage(reader), expected[p]) == 0);
+        assert((reader->currentStored != NOT_STORED) == (p == 0));
+    }
+    closePageReader(reader);
+
+    for (int p = 0; p < 3; p++) {
+        char *filename = stringJoin(urls[p], ".txt");
+        remove(filename);
+        free(filename);
+    }
+    remove("collection.txt");
+    remove(PAGE_STORE);
+    assert(chdir(cwd) == 0 && rmdir(dir) == 0);
+}
+
+void testFst() {
+    char *terms[] = {"star", "stars", "start", "starting", "tar", "tart"};
+    unsigned int size, root;
+    unsigned char *fst = buildFst(terms, 6, &size, &root);
+
+    for (int t = 0; t < 6; t++) assert(findFstTerm(fst, root, terms[t]) == t);
+    assert(findFstTerm(fst, root, "sta") == -1);
+    assert(findFstTerm(fst, root, "tarts") == -1);
+
+    // Terms sharing a prefix are numbered consecutively
+    int count;
+    assert(findFstPrefix(fst, root, "start", &count) == 2 && count == 2);
+    assert(findFstPrefix(fst, root, "ta", &count) == 4 && count == 2);
+    assert(findFstPrefix(fst, root, "", &count) == 0 && count == 6);
+    assert(findFstPrefix(fst, root, "x", &count) == -1 && count == 0);
+    free(fst);
+}
+
+void testBloom() {
+    char *terms[1000];
+    char word[16];
+    for (int t = 0; t < 1000; t++) {
+        sprintf(word, "term%d", t);
+        terms[t] = strdup(word);
+    }
+
+    unsigned int numBlocks;
+    unsigned char *filter = buildBloomFilter(terms, 1000, &numBlocks);
+    assert(numBlocks == 20);
+    for (int t = 0; t < 1000; t++) assert(bloomMayContain(filter, numBlocks, terms[t]));
+
+    // Terms not in the dictionary are almost always ruled out
+    int found = 0;
+    for (int t = 1000; t < 11000; t++) {
+        sprintf(word, "term%d", t);
+        found += bloomMayContain(filter, numBlocks, word);
+    }
+    assert(found < 200);
+
+    for (int t = 0; t < 1000; t++) free(terms[t]);
+    free(filter);
+}
+
+void testCache() {
+    size_t size;
+    resultCache cache = newResultCache(2 * (sizeof(struct _cacheEntry) + 4));
+    cacheResult(cache, "a", "1", 1);
+    cacheResult(cache, "b", "2", 1);
+
+    char *result = findCachedResult(cache, "a", &size);
+    assert(result != NULL && size == 1 && strcmp(result, "1") == 0);
+    free(result);
+
+    // The clock spares the entry used since it was added
+    cacheResult(cache, "c", "3", 1);
+    assert(findCachedResult(cache, "b", &size) == NULL);
+    result = findCachedResult(cache, "a", &size);
+    assert(result != NULL);
+    free(result);
+    assert(cache->hits == 2 && cache->misses == 1 && cache->evictions == 1);
+
+    clearResultCache(cache);
+    assert(cache->numEntries == 0 && cache->used == 0);
+    freeResultCache(cache);
+}
@@ -5,6 +5,10 @@
 
 #include "text.h"
 
+static stringBST getCollatedBST(stringBST tree, char *key, collationKey collation);
+static void fillCollationKey(collationKey key, char *string, int length, unsigned char *suffix);
+static void probeCollationKey(collationKey key, char *string, unsigned char *buffer);
+
 // Allocates and returns a new string list
 stringList newStringList() {
     stringList list = malloc(sizeof(struct _stringList));
@@ -18,6 +22,7 @@ stringNode newStringNode(char *contents) {
     node->string = calloc(strlen(contents) + 1, sizeof(char));
     strcpy(node->string, contents);
     node->key = -1;
+    node->collation = NULL;
     node->list = newStringList();
     node->next = NULL;
     return node;
@@ -50,6 +55,12 @@ stringNode getNode(stringList l, char* string) {
     return NULL;
 }
 
+// Returns the collation key of a node, building it on first use
+collationKey getNodeCollation(stringNode n) {
+    if (n->collation == NULL) n->collation = newCollationKey(n->string);
+    return n->collation;
+}
+
 // Inserts a node into a string list in sorted position
 void insertSortedByKey(stringList l, char *contents, double key) {
     stringNode dest = NULL;
@@ -59,8 +70,9 @@ void insertSortedByKey(stringList l, char *contents, double key) {
     for (stringNode curr = l->start; curr != NULL; curr = curr->next) {
         // If node has no key, sort by contents of string
         if (key == NO_KEY || curr->key == key) {
-            if (stringsSorted(curr->string, contents) &&
-                (curr->next == NULL || !stringsSorted(curr->next->string, contents))) {
+            if (collationSorted(getNodeCollation(curr), getNodeCollation(new)) &&
+                (curr->next == NULL ||
+                 !collationSorted(getNodeCollation(curr->next), getNodeCollation(new)))) {
                 dest = curr;
                 break;
             }
@@ -183,6 +195,7 @@ void freeStringList(stringList l) {
     stringNode n = l->start;
     while (n != NULL) {
         freeStringList(n->list);
+        freeCollationKey(n->collation);
         free(n->string);
         stringNode temp = n->next;
         free(n);
@@ -194,27 +207,80 @@ void freeStringList(stringList l) {
 
 // Reads all of the URLs in a collection file
 stringList readCollection(char *filename) {
+    collectionReader reader = openCollection(filename);
+    stringList urls = newStringList();
+
+    char *url;
+    while ((url = nextCollectionUrl(reader)) != NULL) {
+        appendToStringList(urls, url);
+    }
+
+    closeCollection(reader);
+    return urls;
+}
+
+// Counts the URLs in a collection file without storing them
+int countCollection(char *filename) {
+    collectionReader reader = openCollection(filename);
+
+    int count = 0;
+    while (nextCollectionUrl(reader) != NULL) count++;
+
+    closeCollection(reader);
+    return count;
+}
+
+// Opens a collection file for reading one URL at a time
+collectionReader openCollection(char *filename) {
     FILE* f = fopen(filename, "r");
 
     if (f == NULL) {
         printf("ERROR: Could not read collection from file '%s'\n", filename);
         exit(1);
     }
-    
-    // Find size of file and rewind
-    fseek(f, 0, SEEK_END);
-    long size = ftell(f);
-    rewind(f);
 
-    // Allocate buffer and read entire file
-    char *buffer = calloc(size + 1, sizeof(char));
-    fread(buffer, size, 1, f);
-    fclose(f);
+    collectionReader reader = malloc(sizeof(struct _collectionReader));
+    reader->file = f;
+    reader->chunkLength = 0;
+    reader->chunkPos = 0;
+    return reader;
+}
 
-    // Parse words from buffer
-    stringList urls = readWords(buffer);
-    free(buffer);
-    return urls;
+// Returns the next URL in a collection, or NULL once all have been read.
+// The URL is overwritten by the following call, so copy it to keep it
+char *nextCollectionUrl(collectionReader reader) {
+    int length = 0;
+
+    while (1) {
+        // Refill the chunk once it has been consumed
+        if (reader->chunkPos == reader->chunkLength) {
+            reader->chunkLength = fread(reader->chunk, 1, COLLECTION_CHUNK, reader->file);
+            reader->chunkPos = 0;
+            if (reader->chunkLength == 0) break;
+        }
+
+        char c = reader->chunk[reader->chunkPos];
+        reader->chunkPos++;
+
+        // URLs are separated by spaces and newlines, as in readWords
+        if (c == ' ' || c == '\n' || c == '\0') {
+            if (length > 0) break;
+        } else if (length < BUFFER_SIZE - 1) {
+            reader->url[length] = c;
+            length++;
+        }
+    }
+
+    if (length == 0) return NULL;
+
+    reader->url[length] = '\0';
+    return reader->url;
+}
+
+// Closes a collection reader and frees its memory
+void closeCollection(collectionReader reader) {
+    fclose(reader->file);
+    free(reader);
 }
 
 // Reads a section from a file and returns its contents
@@ -226,30 +292,82 @@ char *readSection(char *filename, char *section) {
         exit(1);
     }
 
-    char buffer[MAX_LINE];
-    int pos = 0;
-    int start = -1;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    char *contents = malloc(size + 1);
+    size = fread(contents, 1, size, f);
+    contents[size] = '\0';
+    fclose(f);
+
+    char *sectionText = findSection(contents, section);
+    free(contents);
 
+    return sectionText;
+}
+
+// Returns a copy of a section of a page's contents
+char *findSection(char *contents, char *section) {
+    int length;
+    int start = findSectionSpan(contents, section, &length);
+
+    char *sectionText = malloc(length + 1);
+    memcpy(sectionText, contents + start, length);
+    sectionText[length] = '\0';
+
+    return sectionText;
+}
+
+// Finds where a section lies in a page's contents: the lines after the
+// last start tag line before the first end tag line, up to the end tag.
+// Returns the offset of the section, and sets its length
+int findSectionSpan(char *contents, char *section, int *length) {
     char *startTag = stringJoin("#start ", section);
     char *endTag = stringJoin("#end ", section);
+    char *start = contents;
+    char *line = contents;
 
-    while(fgets(buffer, MAX_LINE, f)) { 
-        if (stringStartsWith(buffer, startTag)) start = strlen(buffer) + pos;
-        else if (stringStartsWith(buffer, endTag)) break;
+    while (*line != '\0' && !stringStartsWith(line, endTag)) {
+        char *next = strchr(line, '\n');
+        next = next == NULL ? line + strlen(line) : next + 1;
 
-        pos += strlen(buffer);     
+        if (stringStartsWith(line, startTag)) start = next;
+        line = next;
     }
 
-    int length = pos - start;
-
     free(startTag);
     free(endTag);
 
-    fseek(f, start, SEEK_SET);
-    char *sectionText = calloc(length + 1, sizeof(char));
-    fread(sectionText, 1, length, f);
+    *length = line - start;
+    return start - contents;
+}
 
-    return sectionText;
+// Allocates and returns a new, empty ID vector
+idVector newIdVector() {
+    idVector v = malloc(sizeof(struct _idVector));
+    v->ids = NULL;
+    v->length = 0;
+    v->capacity = 0;
+    return v;
+}
+
+// Appends an ID to the end of an ID vector
+void appendIdVector(idVector v, int id) {
+    if (v->length == v->capacity) {
+        v->capacity = v->capacity == 0 ? 4 : v->capacity * 2;
+        v->ids = realloc(v->ids, v->capacity * sizeof(int));
+    }
+
+    v->ids[v->length] = id;
+    v->length++;
+}
+
+// Frees the memory occupied by an ID vector
+void freeIdVector(idVector v) {
+    if (v == NULL) return;
+    free(v->ids);
+    free(v);
 }
 
 // Returns a new binary search tree node with the given key
@@ -257,30 +375,56 @@ stringBST newStringBST(char *key) {
     stringBST new = malloc(sizeof(struct _stringBST));
     new->left = NULL;
     new->right = NULL;
-    new->list = newStringList();
+    new->ids = newIdVector();
+    new->freqs = newIdVector();
+    new->positions = NULL;
     new->key = calloc(strlen(key) + 1, sizeof(char));
     strcpy(new->key, key);
+    new->collation = newCollationKey(key);
     return new;
 }
 
-// Returns the BST node with the given key
+// Returns the BST node with the given key, descending by collation key
+static stringBST getCollatedBST(stringBST tree, char *key, collationKey collation) {
+    while (tree != NULL && strcmp(tree->key, key) != 0) {
+        if (collationSorted(collation, tree->collation)) tree = tree->left;
+        else tree = tree->right;
+    }
+    return tree;
+}
+
+// Returns the BST node with the given key. The key's collation key is
+// built on the stack, as lookups are made for every word indexed
 stringBST getKeyBST(stringBST tree, char *key) {
     if (tree == NULL) return NULL;
-    if (strcmp(tree->key, key) == 0) return tree;
-    
-    if (stringsSorted(key, tree->key)) return getKeyBST(tree->left, key);
-    else return getKeyBST(tree->right, key);
+
+    struct _collationKey collation;
+    unsigned char buffer[PROBE_SUFFIX];
+    probeCollationKey(&collation, key, buffer);
+
+    stringBST found = getCollatedBST(tree, key, &collation);
+    if (collation.suffix != buffer) free(collation.suffix);
+    return found;
 }
 
-// Inserts a node into a tree with the given key
-void insertKeyBST(stringBST tree, char *key) {
-    if (stringsSorted(key, tree->key)) {      
-        if (tree->left == NULL) tree->left = newStringBST(key);
-        else insertKeyBST(tree->left, key);
-    }
-    else {
-        if (tree->right == NULL) tree->right = newStringBST(key);
-        else insertKeyBST(tree->right, key);
+// Inserts a node into a tree with the given key, and returns the new node
+stringBST insertKeyBST(stringBST tree, char *key) {
+    stringBST new = newStringBST(key);
+
+    while (1) {
+        if (collationSorted(new->collation, tree->collation)) {
+            if (tree->left == NULL) {
+                tree->left = new;
+                return new;
+            }
+            tree = tree->left;
+        } else {
+            if (tree->right == NULL) {
+                tree->right = new;
+                return new;
+            }
+            tree = tree->right;
+        }
     }
 }
 
@@ -292,16 +436,117 @@ void printBST(stringBST tree) {
     printBST(tree->right);
 }
 
+// Adds the nodes of a BST to an array in-order
+void collectBST(stringBST tree, stringBST *nodes, int *pos) {
+    if (tree == NULL) return;
+    collectBST(tree->left, nodes, pos);
+    nodes[*pos] = tree;
+    (*pos)++;
+    collectBST(tree->right, nodes, pos);
+}
+
 // Frees the memory associated with a BST
 void freeStringBST(stringBST tree) {
     if (tree == NULL) return;
     freeStringBST(tree->left);
     freeStringBST(tree->right);
-    freeStringList(tree->list);
+    freeIdVector(tree->ids);
+    freeIdVector(tree->freqs);
+    freeIdVector(tree->positions);
+    freeCollationKey(tree->collation);
     free(tree->key);
     free(tree);
 }
 
+// Builds the collation key of a string. Each character is lowercased, then
+// has its sign bit flipped so that unsigned byte order matches the signed
+// character comparison used by stringsSorted
+collationKey newCollationKey(char *string) {
+    collationKey key = malloc(sizeof(struct _collationKey));
+    int length = strlen(string);
+    fillCollationKey(key, string, length, length > 8 ? malloc(length - 8) : NULL);
+    return key;
+}
+
+// Builds the collation key of a string into key, keeping the bytes after
+// the first 8 in suffix, which must have room for them
+static void fillCollationKey(collationKey key, char *string, int length, unsigned char *suffix) {
+    key->length = length;
+    key->prefix = 0;
+    key->suffix = suffix;
+
+    for (int i = 0; i < key->length; i++) {
+        char c = tolower(string[i]);
+        unsigned char byte = (unsigned char)c ^ 0x80;
+
+        if (i < 8) key->prefix |= (unsigned long long)byte << ((7 - i) * 8);
+        else key->suffix[i - 8] = byte;
+    }
+}
+
+// Builds the collation key of a string for a single comparison, keeping its
+// suffix in a buffer of PROBE_SUFFIX bytes unless it is longer. The suffix
+// must be freed by the caller if it is not the buffer
+static void probeCollationKey(collationKey key, char *string, unsigned char *buffer) {
+    int length = strlen(string);
+    fillCollationKey(key, string, length, length - 8 > PROBE_SUFFIX ? malloc(length - 8) : buffer);
+}
+
+// Collation key equivalent of stringsSorted. Only the bytes both keys share
+// are compared, so a key that is a prefix of the other sorts either way
+int collationSorted(collationKey key1, collationKey key2) {
+    int shared = key1->length < key2->length ? key1->length : key2->length;
+
+    // Mask off the prefix bytes beyond the shorter key
+    unsigned long long mask = shared >= 8 ? ~0ULL : ~(~0ULL >> (shared * 8));
+    unsigned long long prefix1 = key1->prefix & mask;
+    unsigned long long prefix2 = key2->prefix & mask;
+
+    if (prefix1 != prefix2) return prefix1 < prefix2;
+    if (shared <= 8) return 1;
+    return memcmp(key1->suffix, key2->suffix, shared - 8) <= 0;
+}
+
+// Strict three-way comparison of collation keys. Unlike collationSorted,
+// a key that is a prefix of the other always sorts first
+int collationCompare(collationKey key1, collationKey key2) {
+    int shared = key1->length < key2->length ? key1->length : key2->length;
+
+    if (key1->prefix != key2->prefix) {
+        return key1->prefix < key2->prefix ? -1 : 1;
+    }
+
+    if (shared > 8) {
+        int cmp = memcmp(key1->suffix, key2->suffix, shared - 8);
+        if (cmp != 0) return cmp;
+    }
+
+    return key1->length - key2->length;
+}
+
+// Orders two strings as collationCompare orders their keys, then by their
+// exact string. The keys are built on the stack for the comparison
+int compareCollated(char *string1, char *string2) {
+    struct _collationKey key1, key2;
+    unsigned char buffer1[PROBE_SUFFIX], buffer2[PROBE_SUFFIX];
+    probeCollationKey(&key1, string1, buffer1);
+    probeCollationKey(&key2, string2, buffer2);
+
+    int cmp = collationCompare(&key1, &key2);
+    if (key1.suffix != buffer1) free(key1.suffix);
+    if (key2.suffix != buffer2) free(key2.suffix);
+
+    if (cmp != 0) return cmp;
+    return strcmp(string1, string2);
+}
+
+// Frees the memory occupied by a collation key
+void freeCollationKey(collationKey key) {
+    if (key == NULL) return;
+    free(key->suffix);
+    free(key);
+}
+
 // Checks whether string1 is alphabetically above string2
 int stringsSorted(char *string1, char *string2) {
     int i = 0;
@@ -1,25 +1,47 @@
 #ifndef TEXT_H
 #define TEXT_H
 
+#include <stdio.h>
+
 #define BUFFER_SIZE 256
 #define MAX_LINE 1024
+#define COLLECTION_CHUNK 4096
 
 #define NO_KEY -1
 
+// Longest collation key suffix built on the stack when probing a tree
+#define PROBE_SUFFIX 56
+
 typedef struct _stringList *stringList;
 typedef struct _stringNode *stringNode;
 typedef struct _stringBST *stringBST;
+typedef struct _collationKey *collationKey;
+typedef struct _collectionReader *collectionReader;
+typedef struct _idVector *idVector;
+
+// Normalised sort key for a string, compared in place of the string itself.
+// The first 8 bytes are packed into an integer so most comparisons are
+// settled by a single integer compare
+struct _collationKey {
+    unsigned long long prefix;
+    int length;
+    unsigned char *suffix;
+};
 
 struct _stringBST {
     char *key;
+    collationKey collation;
     stringBST left;
     stringBST right;
-    stringList list;
+    idVector ids;
+    idVector freqs;
+    idVector positions;
 };
 
 struct _stringNode {
     char *string;
     double key;
+    collationKey collation;
     stringList list;
     stringNode next;
 };
@@ -29,6 +51,22 @@ struct _stringList {
     stringNode end;
 };
 
+// Append-only array of document IDs
+struct _idVector {
+    int *ids;
+    int length;
+    int capacity;
+};
+
+// Reads the URLs of a collection file a chunk at a time
+struct _collectionReader {
+    FILE *file;
+    char chunk[COLLECTION_CHUNK];
+    int chunkLength;
+    int chunkPos;
+    char url[BUFFER_SIZE];
+};
+
 stringList newStringList();
 stringNode newStringNode(char *contents);
 
@@ -46,16 +84,34 @@ void printStringList2D(stringList l);
 
 void freeStringList(stringList l);
 
+idVector newIdVector();
+void appendIdVector(idVector v, int id);
+void freeIdVector(idVector v);
+
 stringBST newStringBST();
 stringBST getKeyBST(stringBST tree, char *key);
-void insertKeyBST(stringBST tree, char *key);
+stringBST insertKeyBST(stringBST tree, char *key);
 void printBST(stringBST tree);
+void collectBST(stringBST tree, stringBST *nodes, int *pos);
 void freeStringBST(stringBST tree);
 
 stringList readWords(char* string);
 stringList splitString(char *string, char *delimiters);
 stringList readCollection(char *filename);
+int countCollection(char *filename);
+collectionReader openCollection(char *filename);
+char *nextCollectionUrl(collectionReader reader);
+void closeCollection(collectionReader reader);
 char *readSection(char *filename, char *section);
+char *findSection(char *contents, char *section);
+int findSectionSpan(char *contents, char *section, int *length);
+
+collationKey newCollationKey(char *string);
+int collationSorted(collationKey key1, collationKey key2);
+int collationCompare(collationKey key1, collationKey key2);
+int compareCollated(char *string1, char *string2);
+collationKey getNodeCollation(stringNode n);
+void freeCollationKey(collationKey key);
 
 int stringsSorted(char *string1, char *string2);
 int stringStartsWith(char *string, char *match);
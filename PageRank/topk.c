@@ -0,0 +1,236 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "topk.h"
+
+#define NO_PIVOT -1
+
+// A query term's postings within one segment, with a bound on how much it
+// can add to the rank of any document containing it
+struct termCursor {
+    struct postingCursor postings;
+    int term;               // Number of the term within the query
+    int indexTerm;          // Number of the term in the segment's index, NO_TERM for a phrase
+    double bound;
+    unsigned char *encoded; // A phrase's matches, encoded as postings
+};
+
+static void findTopInSegment(query q, segmentSet set, int s, double *idfs, topDocs top);
+static struct rankedDoc scoreDoc(query q, segmentSet set, int s, struct termCursor *cursors,
+    double *idfs, int doc);
+static double getBlockRankBound(invertedIndex index, struct termCursor *c, double idf,
+    int target, int *lastDoc);
+static void sortCursors(struct termCursor **order, int numCursors);
+static void siftDown(topDocs top, int i);
+
+// Allocates an empty set of best documents, holding at most size of them
+topDocs newTopDocs(int size) {
+    topDocs top = malloc(sizeof(struct _topDocs));
+    top->size = size;
+    top->numDocs = 0;
+    top->docs = calloc(size, sizeof(struct rankedDoc));
+    return top;
+}
+
+// Keeps a document if it is among the best found so far, dropping the
+// worst kept document if there is no room. Returns whether it was kept
+int offerTopDoc(topDocs top, struct rankedDoc doc) {
+    if (top->numDocs < top->size) {
+        int i = top->numDocs;
+        top->docs[i] = doc;
+        top->numDocs++;
+
+        // Move the document up while it is worse than its parent
+        while (i > 0 && compareRankedDocs(&top->docs[(i - 1) / 2], &top->docs[i]) < 0) {
+            struct rankedDoc swap = top->docs[i];
+            top->docs[i] = top->docs[(i - 1) / 2];
+            top->docs[(i - 1) / 2] = swap;
+            i = (i - 1) / 2;
+        }
+        return 1;
+    }
+
+    if (top->size == 0 || compareRankedDocs(&doc, &top->docs[0]) >= 0) return 0;
+
+    top->docs[0] = doc;
+    siftDown(top, 0);
+    return 1;
+}
+
+// Sorts the kept documents from best to worst
+void sortTopDocs(topDocs top) {
+    qsort(top->docs, top->numDocs, sizeof(struct rankedDoc), compareRankedDocs);
+}
+
+// Frees the memory occupied by a set of best documents
+void freeTopDocs(topDocs top) {
+    free(top->docs);
+    free(top);
+}
+
+// Finds the size best documents for a query by tf-idf, ranked as
+// sortMatches ranks them, given the idf of each query term. Each segment's
+// documents are visited in ID order with Block-Max WAND, which skips every
+// document whose bounds show it cannot beat the worst document kept
+topDocs findTopTfIdf(query q, segmentSet set, double *idfs, int size) {
+    topDocs top = newTopDocs(size);
+    for (int s = 0; s < set->numSegments; s++) findTopInSegment(q, set, s, idfs, top);
+    sortTopDocs(top);
+    return top;
+}
+
+// Offers the documents of one segment that could rank among the best.
+// With the cursors sorted by document, the pivot is the first document that
+// the terms up to it could together lift past the worst document kept.
+// Every document before the pivot is skipped. The bounds of the blocks
+// holding the pivot are then checked, and if they fall short, every
+// document up to the end of the first of those blocks is skipped too
+static void findTopInSegment(query q, segmentSet set, int s, double *idfs, topDocs top) {
+    segment seg = set->segments[s];
+    struct termCursor *cursors = calloc(q->numTerms, sizeof(struct termCursor));
+    struct termCursor **order = calloc(q->numTerms, sizeof(struct termCursor *));
+
+    for (int t = 0; t < q->numTerms; t++) {
+        struct termCursor *c = &cursors[t];
+        c->term = t;
+        c->indexTerm = NO_TERM;
+        c->encoded = NULL;
+
+        if (q->phrases[t] != NULL) {
+            phraseMatches matches = q->phrases[t][s];
+            c->encoded = malloc(skipPostingsBound(matches->numDocs));
+            encodeSkipPostings(matches->docs, matches->numDocs, c->encoded);
+            openCursor(&c->postings, c->encoded, matches->numDocs);
+
+            // A phrase cannot start more times than its document has words
+            c->bound = (1 + idfs[t]) * BOUND_SLACK;
+        } else {
+            c->indexTerm = findTerm(seg->index, q->terms[t]);
+            if (c->indexTerm == NO_TERM) {
+                openCursor(&c->postings, NULL, 0);
+            } else {
+                openTermCursor(seg->index, c->indexTerm, &c->postings);
+                c->bound = (1 + seg->index->terms[c->indexTerm].maxTf * idfs[t]) * BOUND_SLACK;
+            }
+        }
+
+        nextPosting(&c->postings);
+        order[t] = c;
+    }
+
+    while (1) {
+        sortCursors(order, q->numTerms);
+        int full = top->numDocs == top->size;
+        double threshold = full ? top->docs[0].key : 0;
+
+        int pivot = NO_PIVOT;
+        double sum = 0;
+        for (int i = 0; i < q->numTerms && order[i]->postings.doc != END_POSTING; i++) {
+            sum += order[i]->bound;
+            if (sum >= threshold) {
+                pivot = i;
+                break;
+            }
+        }
+
+        if (pivot == NO_PIVOT) break;
+
+        // Every term already at the pivot counts towards it
+        int doc = order[pivot]->postings.doc;
+        int last = pivot;
+        while (last + 1 < q->numTerms && order[last + 1]->postings.doc == doc) last++;
+
+        if (full) {
+            int next = last + 1 < q->numTerms ? order[last + 1]->postings.doc : END_POSTING;
+            double blockSum = 0;
+
+            for (int i = 0; i <= last; i++) {
+                int lastDoc;
+                blockSum += getBlockRankBound(seg->index, order[i], idfs[order[i]->term], doc, &lastDoc);
+                if (lastDoc + 1 < next) next = lastDoc + 1;
+            }
+
+            if (blockSum < threshold) {
+                for (int i = 0; i <= last; i++) seekPosting(&order[i]->postings, next);
+                continue;
+            }
+        }
+
+        if (order[0]->postings.doc == doc) {
+            if (isLiveDoc(seg, doc)) offerTopDoc(top, scoreDoc(q, set, s, cursors, idfs, doc));
+            for (int i = 0; i <= last; i++) nextPosting(&order[i]->postings);
+        } else {
+            for (int i = 0; i < pivot; i++) seekPosting(&order[i]->postings, doc);
+        }
+    }
+
+    for (int t = 0; t < q->numTerms; t++) free(cursors[t].encoded);
+    free(cursors);
+    free(order);
+}
+
+// Scores a document from every term whose cursor is on it. Terms are added
+// in query order, as the exhaustive scorer adds them, so that both give
+// exactly the same scores
+static struct rankedDoc scoreDoc(query q, segmentSet set, int s, struct termCursor *cursors,
+    double *idfs, int doc) {
+    segment seg = set->segments[s];
+    double score = 0;
+    int count = 0;
+
+    for (int t = 0; t < q->numTerms; t++) {
+        if (cursors[t].postings.doc != doc) continue;
+
+        double tf;
+        if (q->phrases[t] != NULL) tf = calculatePhraseTf(seg->forward, doc, q->phrases[t][s]);
+        else tf = calculateTf(seg->forward, doc, cursors[t].indexTerm);
+
+        score += tf * idfs[t];
+        count++;
+    }
+
+    struct rankedDoc ranked;
+    ranked.key = count + score;
+    ranked.score = score;
+    ranked.id = set->firstIds[s] + doc;
+    ranked.url = getDocUrl(seg->index, doc);
+    return ranked;
+}
+
+// Returns a bound on what a term adds to the rank of any document in the
+// block that seeking to target would stop in, and sets lastDoc to the
+// block's last document
+static double getBlockRankBound(invertedIndex index, struct termCursor *c, double idf,
+    int target, int *lastDoc) {
+    int block = findPostingBlock(&c->postings, target, lastDoc);
+    if (c->indexTerm == NO_TERM) return c->bound;
+    return (1 + getBlockBound(index, c->indexTerm, block) * idf) * BOUND_SLACK;
+}
+
+// Sorts cursors by their current document, with finished cursors last
+static void sortCursors(struct termCursor **order, int numCursors) {
+    for (int i = 1; i < numCursors; i++) {
+        for (int j = i; j > 0 && order[j]->postings.doc < order[j - 1]->postings.doc; j--) {
+            struct termCursor *swap = order[j];
+            order[j] = order[j - 1];
+            order[j - 1] = swap;
+        }
+    }
+}
+
+// Moves a document down the heap until it is no better than its children
+static void siftDown(topDocs top, int i) {
+    while (1) {
+        int worst = i;
+        for (int child = 2 * i + 1; child <= 2 * i + 2 && child < top->numDocs; child++) {
+            if (compareRankedDocs(&top->docs[child], &top->docs[worst]) > 0) worst = child;
+        }
+
+        if (worst == i) return;
+
+        struct rankedDoc swap = top->docs[i];
+        top->docs[i] = top->docs[worst];
+        top->docs[worst] = swap;
+        i = worst;
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef TOPK_H
+#define TOPK_H
+
+#include "search.h"
+
+// Number of results printed by the search programs
+#define NUM_RESULTS 30
+
+// Scale applied to score bounds, so that rounding while adding up bounds
+// can never leave them below the exact scores they bound
+#define BOUND_SLACK 1.000000001
+
+typedef struct _topDocs *topDocs;
+
+// The best documents found so far, at most size of them, kept as a heap
+// with the worst at the root until they are sorted
+struct _topDocs {
+    int size;
+    int numDocs;
+    struct rankedDoc *docs;
+};
+
+topDocs newTopDocs(int size);
+int offerTopDoc(topDocs top, struct rankedDoc doc);
+void sortTopDocs(topDocs top);
+void freeTopDocs(topDocs top);
+
+topDocs findTopTfIdf(query q, segmentSet set, double *idfs, int size);
+
+#endif
@@ -0,0 +1,40 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "indexer.h"
+#include "segments.h"
+
+int main(int argc, char *argv[]) {
+    int deleting = 0;
+    int arg = 1;
+
+    // -d deletes the pages instead of adding or replacing them
+    if (arg < argc && strcmp(argv[arg], "-d") == 0) {
+        deleting = 1;
+        arg++;
+    }
+
+    if (arg == argc) {
+        printf("ERROR: No URLs given\n");
+        printf("updateIndex [-d] url...\n");
+        exit(1);
+    }
+
+    int numThreads = defaultThreads();
+    char *name = addSegment(argv + arg, argc - arg, deleting, numThreads);
+    printf("%s\n", name);
+    free(name);
+
+    // Compact segments in the background so the update returns at once.
+    // If no process can be started, merging waits for the next update
+    fflush(stdout);
+    if (fork() == 0) {
+        setsid();
+        while (mergeSegments(0, numThreads));
+        _exit(0);
+    }
+
+    return 0;
+}
@@ -0,0 +1,12 @@
+#ifndef WEIGHTED_RANK_H
+#define WEIGHTED_RANK_H
+
+#include "graph.h"
+
+void pageRankW(graph g, double d, double diffPR, int maxIterations);
+double getWIn(graph g, int v, int u);
+double getWOut(graph g, int v, int u);
+int getNumIn(graph g, int id);
+int getNumOut(graph g, int id);
+
+#endif